@@ -0,0 +1,392 @@
+// Benchmark of the routing core on synthetic road graphs, built without R
+// (see CMakeLists.txt). Every phase is run --repeat times and reported as one
+// CSV row with the median and minimum wall time in seconds. Graphs and query
+// nodes only depend on --seed, so numbers are comparable across builds.
+// --heap selects the priority queue of the Dijkstra phases, and
+// --check-heaps verifies that both heaps give the same costs and
+// settled-node counts.
+//
+// Graphs:
+//   grid       jittered square grid with a few missing edges
+//   geometric  random geometric graph: uniform points joined to their three
+//              nearest neighbours
+#include "graph.h"
+#include "dist_mat.h"
+#include "isochrone.h"
+#include "landmarks.h"
+#include "search_policies.h"
+#include "search_workspace.h"
+#include "spatial_index.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+// Mean distance between neighbouring nodes in m
+const double NODE_SPACING = 100.0;
+
+struct Options {
+  std::vector<std::string> graphs = {"grid", "geometric"};
+  std::vector<long> nodes = {10000, 100000, 1000000};
+  int queries = 64;
+  int repeat = 3;
+  std::uint64_t seed = 1;
+  std::string order = "input";
+  SearchWorkspace::HeapType heap = SearchWorkspace::HEAP_DARY;
+  bool check_heaps = false;
+  bool ch = false;
+};
+
+// Uniform double in [0, 1) from the raw engine output, so that the generated
+// graphs do not depend on the standard library's distributions
+double uniform(std::mt19937_64& rng) {
+  return (rng() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Speed class of a road, in km/h
+double road_speed(std::mt19937_64& rng) {
+  static const double speeds[] = {30, 30, 50, 50, 50, 70, 100, 130};
+  return speeds[rng() % 8];
+}
+
+Graph::Oneway road_oneway(std::mt19937_64& rng) {
+  double u = uniform(rng);
+  return u < 0.85 ? Graph::ONEWAY_B : (u < 0.95 ? Graph::ONEWAY_FT : Graph::ONEWAY_TF);
+}
+
+void add_road(Graph::Arrays& arrays, int from, int to, std::mt19937_64& rng) {
+  double d = std::hypot(arrays.node_x[to] - arrays.node_x[from], arrays.node_y[to] - arrays.node_y[from]);
+  arrays.edge_from.push_back(from);
+  arrays.edge_to.push_back(to);
+  arrays.edge_speed.push_back(static_cast<Graph::Weight>(road_speed(rng)));
+  arrays.edge_length.push_back(static_cast<Graph::Weight>(d * (1.0 + 0.3 * uniform(rng))));
+  arrays.edge_oneway.push_back(road_oneway(rng));
+}
+
+// Nodes in row-major order; every row is a connected path, 5% of the
+// vertical edges are missing
+Graph::Arrays make_grid(long n, std::mt19937_64& rng) {
+  int side = std::max(2, static_cast<int>(std::lround(std::sqrt(static_cast<double>(n)))));
+  int count = side * side;
+  Graph::Arrays arrays;
+  arrays.node_x.resize(count);
+  arrays.node_y.resize(count);
+  for (int i = 0; i < count; ++i) {
+    arrays.node_x[i] = (i % side + 0.4 * (uniform(rng) - 0.5)) * NODE_SPACING;
+    arrays.node_y[i] = (i / side + 0.4 * (uniform(rng) - 0.5)) * NODE_SPACING;
+  }
+  for (int i = 0; i < count; ++i) {
+    if (i % side + 1 < side) {
+      add_road(arrays, i, i + 1, rng);
+    }
+    if (i / side + 1 < side && uniform(rng) >= 0.05) {
+      add_road(arrays, i, i + side, rng);
+    }
+  }
+  arrays.name_offsets.assign(count + 1, 0);
+  return arrays;
+}
+
+// Uniform points in a square with about one point per NODE_SPACING^2, each
+// joined to its three nearest neighbours (found on a grid of cells)
+Graph::Arrays make_geometric(long n, std::mt19937_64& rng) {
+  int count = static_cast<int>(std::max(2L, n));
+  int side = std::max(1, static_cast<int>(std::sqrt(static_cast<double>(count))));
+  double extent = side * NODE_SPACING;
+  Graph::Arrays arrays;
+  arrays.node_x.resize(count);
+  arrays.node_y.resize(count);
+  for (int i = 0; i < count; ++i) {
+    arrays.node_x[i] = uniform(rng) * extent;
+    arrays.node_y[i] = uniform(rng) * extent;
+  }
+
+  std::vector<int> cell_offsets(static_cast<std::size_t>(side) * side + 1, 0);
+  std::vector<int> cell(count);
+  for (int i = 0; i < count; ++i) {
+    int cx = std::min(side - 1, static_cast<int>(arrays.node_x[i] / NODE_SPACING));
+    int cy = std::min(side - 1, static_cast<int>(arrays.node_y[i] / NODE_SPACING));
+    cell[i] = cy * side + cx;
+    cell_offsets[cell[i] + 1]++;
+  }
+  for (std::size_t c = 0; c + 1 < cell_offsets.size(); ++c) {
+    cell_offsets[c + 1] += cell_offsets[c];
+  }
+  std::vector<int> cell_nodes(count);
+  std::vector<int> position(cell_offsets.begin(), cell_offsets.end() - 1);
+  for (int i = 0; i < count; ++i) {
+    cell_nodes[position[cell[i]]++] = i;
+  }
+
+  // Three nearest neighbours within growing rings of cells
+  std::vector<std::pair<int, int>> pairs;
+  pairs.reserve(3 * static_cast<std::size_t>(count));
+  std::vector<std::pair<double, int>> candidates;
+  for (int i = 0; i < count; ++i) {
+    int cx = cell[i] % side;
+    int cy = cell[i] / side;
+    candidates.clear();
+    for (int r = 1; candidates.size() < 3 && r <= side; ++r) {
+      candidates.clear();
+      for (int y = std::max(0, cy - r); y <= std::min(side - 1, cy + r); ++y) {
+        for (int x = std::max(0, cx - r); x <= std::min(side - 1, cx + r); ++x) {
+          for (int k = cell_offsets[y * side + x]; k < cell_offsets[y * side + x + 1]; ++k) {
+            int j = cell_nodes[k];
+            if (j != i) {
+              double d = std::hypot(arrays.node_x[j] - arrays.node_x[i], arrays.node_y[j] - arrays.node_y[i]);
+              candidates.push_back({d, j});
+            }
+          }
+        }
+      }
+    }
+    std::size_t k = std::min<std::size_t>(3, candidates.size());
+    std::partial_sort(candidates.begin(), candidates.begin() + k, candidates.end());
+    for (std::size_t c = 0; c < k; ++c) {
+      pairs.push_back({std::min(i, candidates[c].second), std::max(i, candidates[c].second)});
+    }
+  }
+  std::sort(pairs.begin(), pairs.end());
+  pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+  for (const std::pair<int, int>& pair : pairs) {
+    add_road(arrays, pair.first, pair.second, rng);
+  }
+  arrays.name_offsets.assign(count + 1, 0);
+  return arrays;
+}
+
+// Costs and settled-node counts of the Dijkstra distance matrix and isochrone
+// kernels with one heap
+struct HeapRun {
+  std::vector<double> cost;
+  std::vector<std::uint64_t> settled;
+};
+
+HeapRun run_heap(Graph& graph, int profile, const std::vector<int>& queries, const std::vector<double>& lim,
+                 const Metric& metric, SearchWorkspace::HeapType heap) {
+  graph.workspaces().set_dijkstra_heap(heap);
+  HeapRun result;
+  std::vector<QueryStats> stats;
+  result.cost.resize(queries.size() * queries.size());
+  parallelCalculateDistMat(graph, profile, queries, queries, metric, "dijkstra", "none",
+                           DistMatOutput::matrix(result.cost.data(), queries.size(), -1.0), nullptr, &stats);
+  for (const QueryStats& query : stats) {
+    result.settled.push_back(query.settled);
+  }
+  for (const IsochroneColumns& chunk : parallelCalculateIsochrone(graph, profile, queries, lim, metric, "dijkstra", &stats)) {
+    for (std::size_t k = 0; k < chunk.size(); ++k) {
+      result.cost.push_back(chunk.end[k]);
+      result.cost.push_back(chunk.cost[k]);
+    }
+  }
+  for (const QueryStats& query : stats) {
+    result.settled.push_back(query.settled);
+  }
+  return result;
+}
+
+// Throws unless the 4-ary and the radix heap give the same results
+void check_heaps(Graph& graph, int profile, const std::vector<int>& queries, const std::vector<double>& lim,
+                 const Metric& metric, SearchWorkspace::HeapType heap) {
+  HeapRun dary = run_heap(graph, profile, queries, lim, metric, SearchWorkspace::HEAP_DARY);
+  HeapRun radix = run_heap(graph, profile, queries, lim, metric, SearchWorkspace::HEAP_RADIX);
+  graph.workspaces().set_dijkstra_heap(heap);
+  if (dary.cost != radix.cost) {
+    throw std::runtime_error("The 4-ary and radix heaps give different costs.");
+  }
+  if (dary.settled != radix.settled) {
+    throw std::runtime_error("The 4-ary and radix heaps settle different numbers of nodes.");
+  }
+}
+
+// Runs f repeat times and prints one CSV row
+void measure(const std::string& graph, int nodes, std::size_t edges, const std::string& phase, int repeat,
+             const std::function<void()>& f) {
+  std::vector<double> seconds;
+  for (int r = 0; r < repeat; ++r) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    f();
+    seconds.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+  }
+  std::sort(seconds.begin(), seconds.end());
+  std::printf("%s,%d,%zu,%s,%.6f,%.6f\n", graph.c_str(), nodes, edges, phase.c_str(), seconds[seconds.size() / 2],
+              seconds[0]);
+  std::fflush(stdout);
+}
+
+void run(const std::string& name, long n, const Options& options) {
+  std::mt19937_64 rng(options.seed);
+  Graph::Arrays arrays = name == "grid" ? make_grid(n, rng) : make_geometric(n, rng);
+  int nodes = static_cast<int>(arrays.node_x.size());
+  std::size_t edges = arrays.edge_from.size();
+  Graph::NodeOrder order = Graph::parse_node_order(options.order);
+
+  // Query points at input nodes, snapped to the car profile after
+  // construction so that every node order queries the same nodes
+  const int profile = Graph::ROUTING_PROFILE_CAR;
+  std::vector<std::pair<double, double>> points(options.queries);
+  for (std::pair<double, double>& point : points) {
+    std::size_t i = rng() % arrays.node_x.size();
+    point = std::make_pair(arrays.node_x[i], arrays.node_y[i]);
+  }
+
+  std::unique_ptr<Graph> graph;
+  measure(name, nodes, edges, "construct", options.repeat, [&]() {
+    Graph::Arrays copy = arrays;
+    graph.reset(new Graph(std::move(copy), "EPSG:3857", order));
+  });
+  arrays = Graph::Arrays();
+  graph->workspaces().set_dijkstra_heap(options.heap);
+  measure(name, nodes, edges, "activate_profile", options.repeat, [&]() {
+    for (int p = Graph::ROUTING_PROFILE_COUNT - 1; p >= 0; --p) {
+      graph->activate_routing_profile(p);
+    }
+  });
+
+  graph->prepare_spatial_index(profile);
+  std::vector<int> queries;
+  for (const std::pair<double, double>& point : points) {
+    double dist;
+    queries.push_back(graph->spatial_index(profile).nearest(point.first, point.second,
+                                                            std::numeric_limits<double>::infinity(), dist));
+  }
+
+  std::size_t rows = queries.size() * queries.size();
+  std::vector<int> start(rows);
+  std::vector<int> end(rows);
+  std::vector<double> cost(rows);
+  DistMatOutput out = DistMatOutput::columns(start.data(), end.data(), cost.data(), queries.size());
+  Metric time("time");
+  std::vector<double> lim = {5.0, 10.0};
+  if (options.check_heaps) {
+    check_heaps(*graph, profile, queries, lim, time, options.heap);
+  }
+
+  measure(name, nodes, edges, "dist_mat_dijkstra", options.repeat, [&]() {
+    parallelCalculateDistMat(*graph, profile, queries, queries, time, "dijkstra", "none", out);
+  });
+  measure(name, nodes, edges, "prepare_landmarks", 1, [&]() {
+    graph->prepare_landmarks(profile, "time", DEFAULT_LANDMARK_COUNT);
+  });
+  // A* runs one search per pair, so it gets an eighth of the query nodes
+  std::vector<int> alt_queries(queries.begin(), queries.begin() + std::max<std::size_t>(1, queries.size() / 8));
+  measure(name, nodes, edges, "dist_mat_alt", options.repeat, [&]() {
+    parallelCalculateDistMat(*graph, profile, alt_queries, alt_queries, time, "astar", "alt", out);
+  });
+  measure(name, nodes, edges, "isochrone_dijkstra", options.repeat, [&]() {
+    parallelCalculateIsochrone(*graph, profile, queries, lim, time, "dijkstra");
+  });
+
+  if (options.ch) {
+    measure(name, nodes, edges, "prepare_ch", 1, [&]() {
+      graph->prepare_contraction_hierarchy(profile, "time");
+    });
+    measure(name, nodes, edges, "dist_mat_ch", options.repeat, [&]() {
+      parallelCalculateDistMat(*graph, profile, queries, queries, time, "ch", "none", out);
+    });
+    measure(name, nodes, edges, "isochrone_phast", options.repeat, [&]() {
+      parallelCalculateIsochrone(*graph, profile, queries, lim, time, "phast");
+    });
+  }
+}
+
+template <typename T>
+std::vector<T> parse_list(const std::string& value) {
+  std::vector<T> items;
+  std::stringstream stream(value);
+  std::string item;
+  while (std::getline(stream, item, ',')) {
+    std::stringstream parser(item);
+    T parsed;
+    if (!(parser >> parsed)) {
+      throw std::runtime_error("Invalid list item: " + item);
+    }
+    items.push_back(parsed);
+  }
+  return items;
+}
+
+void usage() {
+  std::printf(
+    "Usage: georouter_bench [options]\n"
+    "  --graph LIST    grid,geometric (default: both)\n"
+    "  --nodes LIST    approximate node counts (default: 10000,100000,1000000)\n"
+    "  --queries N     query nodes; distance matrices are N x N, N/8 x N/8 for A*\n"
+    "                  (default: 64)\n"
+    "  --repeat N      runs per phase (default: 3)\n"
+    "  --seed N        seed of graphs and queries (default: 1)\n"
+    "  --order NAME    node order: input, hilbert or bfs (default: input)\n"
+    "  --heap NAME     heap of the Dijkstra phases: dary or radix (default: dary)\n"
+    "  --check-heaps   fail unless both heaps give the same costs and settled\n"
+    "                  node counts\n"
+    "  --ch            also time contraction hierarchy phases\n"
+    "Threads: GEOROUTER_NUM_THREADS (default: all hardware threads)\n");
+}
+
+}
+
+int main(int argc, char** argv) {
+  Options options;
+  try {
+    for (int i = 1; i < argc; ++i) {
+      std::string arg = argv[i];
+      bool has_value = i + 1 < argc;
+      if (arg == "--help" || arg == "-h") {
+        usage();
+        return 0;
+      } else if (arg == "--ch") {
+        options.ch = true;
+      } else if (arg == "--check-heaps") {
+        options.check_heaps = true;
+      } else if (arg == "--heap" && has_value) {
+        options.heap = SearchWorkspace::parse_heap(argv[++i]);
+      } else if (arg == "--graph" && has_value) {
+        options.graphs = parse_list<std::string>(argv[++i]);
+      } else if (arg == "--nodes" && has_value) {
+        options.nodes = parse_list<long>(argv[++i]);
+      } else if (arg == "--queries" && has_value) {
+        options.queries = std::max(1, std::atoi(argv[++i]));
+      } else if (arg == "--repeat" && has_value) {
+        options.repeat = std::max(1, std::atoi(argv[++i]));
+      } else if (arg == "--seed" && has_value) {
+        options.seed = std::strtoull(argv[++i], nullptr, 10);
+      } else if (arg == "--order" && has_value) {
+        options.order = argv[++i];
+        Graph::parse_node_order(options.order);
+      } else {
+        usage();
+        return 1;
+      }
+    }
+    for (const std::string& graph : options.graphs) {
+      if (graph != "grid" && graph != "geometric") {
+        throw std::runtime_error("Invalid graph: " + graph);
+      }
+    }
+
+    std::printf("graph,nodes,edges,phase,median_s,min_s\n");
+    for (const std::string& graph : options.graphs) {
+      for (long n : options.nodes) {
+        run(graph, n, options);
+      }
+    }
+  } catch (const std::exception& e) {
+    std::fprintf(stderr, "Error: %s\n", e.what());
+    return 1;
+  }
+  return 0;
+}
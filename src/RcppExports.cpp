@@ -11,8 +11,8 @@ Rcpp::Rostream<false>& Rcpp::Rcerr = Rcpp::Rcpp_cerr_get();
 #endif
 
 // graph_create
-RcppExport SEXP graph_create(SEXP edge_from, SEXP edge_to, SEXP edge_speed, SEXP edge_length, SEXP edge_oneway, SEXP node_name, SEXP node_x, SEXP node_y, SEXP crs);
-RcppExport SEXP _GeoRouteR_graph_create(SEXP edge_fromSEXP, SEXP edge_toSEXP, SEXP edge_speedSEXP, SEXP edge_lengthSEXP, SEXP edge_onewaySEXP, SEXP node_nameSEXP, SEXP node_xSEXP, SEXP node_ySEXP, SEXP crsSEXP) {
+RcppExport SEXP graph_create(SEXP edge_from, SEXP edge_to, SEXP edge_speed, SEXP edge_length, SEXP edge_oneway, SEXP node_name, SEXP node_x, SEXP node_y, SEXP crs, SEXP node_order, SEXP directed);
+RcppExport SEXP _GeoRouteR_graph_create(SEXP edge_fromSEXP, SEXP edge_toSEXP, SEXP edge_speedSEXP, SEXP edge_lengthSEXP, SEXP edge_onewaySEXP, SEXP node_nameSEXP, SEXP node_xSEXP, SEXP node_ySEXP, SEXP crsSEXP, SEXP node_orderSEXP, SEXP directedSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
@@ -25,29 +25,33 @@ BEGIN_RCPP
     Rcpp::traits::input_parameter< SEXP >::type node_x(node_xSEXP);
     Rcpp::traits::input_parameter< SEXP >::type node_y(node_ySEXP);
     Rcpp::traits::input_parameter< SEXP >::type crs(crsSEXP);
-    rcpp_result_gen = Rcpp::wrap(graph_create(edge_from, edge_to, edge_speed, edge_length, edge_oneway, node_name, node_x, node_y, crs));
+    Rcpp::traits::input_parameter< SEXP >::type node_order(node_orderSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type directed(directedSEXP);
+    rcpp_result_gen = Rcpp::wrap(graph_create(edge_from, edge_to, edge_speed, edge_length, edge_oneway, node_name, node_x, node_y, crs, node_order, directed));
     return rcpp_result_gen;
 END_RCPP
 }
 // graph_edges
-RcppExport SEXP graph_edges(SEXP p);
-RcppExport SEXP _GeoRouteR_graph_edges(SEXP pSEXP) {
+RcppExport SEXP graph_edges(SEXP p, SEXP profile);
+RcppExport SEXP _GeoRouteR_graph_edges(SEXP pSEXP, SEXP profileSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
     Rcpp::traits::input_parameter< SEXP >::type p(pSEXP);
-    rcpp_result_gen = Rcpp::wrap(graph_edges(p));
+    Rcpp::traits::input_parameter< SEXP >::type profile(profileSEXP);
+    rcpp_result_gen = Rcpp::wrap(graph_edges(p, profile));
     return rcpp_result_gen;
 END_RCPP
 }
 // graph_nodes
-RcppExport SEXP graph_nodes(SEXP p);
-RcppExport SEXP _GeoRouteR_graph_nodes(SEXP pSEXP) {
+RcppExport SEXP graph_nodes(SEXP p, SEXP profile);
+RcppExport SEXP _GeoRouteR_graph_nodes(SEXP pSEXP, SEXP profileSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
     Rcpp::traits::input_parameter< SEXP >::type p(pSEXP);
-    rcpp_result_gen = Rcpp::wrap(graph_nodes(p));
+    Rcpp::traits::input_parameter< SEXP >::type profile(profileSEXP);
+    rcpp_result_gen = Rcpp::wrap(graph_nodes(p, profile));
     return rcpp_result_gen;
 END_RCPP
 }
@@ -62,6 +66,17 @@ BEGIN_RCPP
     return rcpp_result_gen;
 END_RCPP
 }
+// graph_edge_count
+RcppExport SEXP graph_edge_count(SEXP p);
+RcppExport SEXP _GeoRouteR_graph_edge_count(SEXP pSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type p(pSEXP);
+    rcpp_result_gen = Rcpp::wrap(graph_edge_count(p));
+    return rcpp_result_gen;
+END_RCPP
+}
 // graph_crs
 RcppExport SEXP graph_crs(SEXP p);
 RcppExport SEXP _GeoRouteR_graph_crs(SEXP pSEXP) {
@@ -95,30 +110,165 @@ BEGIN_RCPP
     return R_NilValue;
 END_RCPP
 }
+// graph_save
+void graph_save(SEXP p, SEXP path);
+RcppExport SEXP _GeoRouteR_graph_save(SEXP pSEXP, SEXP pathSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type p(pSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type path(pathSEXP);
+    graph_save(p, path);
+    return R_NilValue;
+END_RCPP
+}
+// graph_update_edge_speeds
+void graph_update_edge_speeds(SEXP p, SEXP edge_ids_sexp, SEXP speeds_sexp);
+RcppExport SEXP _GeoRouteR_graph_update_edge_speeds(SEXP pSEXP, SEXP edge_ids_sexpSEXP, SEXP speeds_sexpSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type p(pSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type edge_ids_sexp(edge_ids_sexpSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type speeds_sexp(speeds_sexpSEXP);
+    graph_update_edge_speeds(p, edge_ids_sexp, speeds_sexp);
+    return R_NilValue;
+END_RCPP
+}
+// graph_prepare_customizable_ch
+void graph_prepare_customizable_ch(SEXP p, SEXP profile);
+RcppExport SEXP _GeoRouteR_graph_prepare_customizable_ch(SEXP pSEXP, SEXP profileSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type p(pSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type profile(profileSEXP);
+    graph_prepare_customizable_ch(p, profile);
+    return R_NilValue;
+END_RCPP
+}
+// graph_set_tree_cache
+void graph_set_tree_cache(SEXP p, SEXP capacity_sexp);
+RcppExport SEXP _GeoRouteR_graph_set_tree_cache(SEXP pSEXP, SEXP capacity_sexpSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type p(pSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type capacity_sexp(capacity_sexpSEXP);
+    graph_set_tree_cache(p, capacity_sexp);
+    return R_NilValue;
+END_RCPP
+}
+// graph_set_search_heap
+void graph_set_search_heap(SEXP p, SEXP heap);
+RcppExport SEXP _GeoRouteR_graph_set_search_heap(SEXP pSEXP, SEXP heapSEXP) {
+BEGIN_RCPP
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type p(pSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type heap(heapSEXP);
+    graph_set_search_heap(p, heap);
+    return R_NilValue;
+END_RCPP
+}
+// graph_tree_cache_stats
+RcppExport SEXP graph_tree_cache_stats(SEXP p);
+RcppExport SEXP _GeoRouteR_graph_tree_cache_stats(SEXP pSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type p(pSEXP);
+    rcpp_result_gen = Rcpp::wrap(graph_tree_cache_stats(p));
+    return rcpp_result_gen;
+END_RCPP
+}
+// graph_load
+RcppExport SEXP graph_load(SEXP path);
+RcppExport SEXP _GeoRouteR_graph_load(SEXP pathSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type path(pathSEXP);
+    rcpp_result_gen = Rcpp::wrap(graph_load(path));
+    return rcpp_result_gen;
+END_RCPP
+}
+// graph_snap
+RcppExport SEXP graph_snap(SEXP p, SEXP profile, SEXP x_sexp, SEXP y_sexp, SEXP max_dist_sexp);
+RcppExport SEXP _GeoRouteR_graph_snap(SEXP pSEXP, SEXP profileSEXP, SEXP x_sexpSEXP, SEXP y_sexpSEXP, SEXP max_dist_sexpSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type p(pSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type profile(profileSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type x_sexp(x_sexpSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type y_sexp(y_sexpSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type max_dist_sexp(max_dist_sexpSEXP);
+    rcpp_result_gen = Rcpp::wrap(graph_snap(p, profile, x_sexp, y_sexp, max_dist_sexp));
+    return rcpp_result_gen;
+END_RCPP
+}
 // calculate_isochrone
-RcppExport SEXP calculate_isochrone(SEXP graph_ptr, SEXP start_nodes_sexp, SEXP lim_sexp);
-RcppExport SEXP _GeoRouteR_calculate_isochrone(SEXP graph_ptrSEXP, SEXP start_nodes_sexpSEXP, SEXP lim_sexpSEXP) {
+RcppExport SEXP calculate_isochrone(SEXP graph_ptr, SEXP profile_sexp, SEXP start_nodes_sexp, SEXP lim_sexp, SEXP mode_sexp, SEXP engine_sexp, SEXP stats_sexp);
+RcppExport SEXP _GeoRouteR_calculate_isochrone(SEXP graph_ptrSEXP, SEXP profile_sexpSEXP, SEXP start_nodes_sexpSEXP, SEXP lim_sexpSEXP, SEXP mode_sexpSEXP, SEXP engine_sexpSEXP, SEXP stats_sexpSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
     Rcpp::traits::input_parameter< SEXP >::type graph_ptr(graph_ptrSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type profile_sexp(profile_sexpSEXP);
     Rcpp::traits::input_parameter< SEXP >::type start_nodes_sexp(start_nodes_sexpSEXP);
     Rcpp::traits::input_parameter< SEXP >::type lim_sexp(lim_sexpSEXP);
-    rcpp_result_gen = Rcpp::wrap(calculate_isochrone(graph_ptr, start_nodes_sexp, lim_sexp));
+    Rcpp::traits::input_parameter< SEXP >::type mode_sexp(mode_sexpSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type engine_sexp(engine_sexpSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type stats_sexp(stats_sexpSEXP);
+    rcpp_result_gen = Rcpp::wrap(calculate_isochrone(graph_ptr, profile_sexp, start_nodes_sexp, lim_sexp, mode_sexp, engine_sexp, stats_sexp));
+    return rcpp_result_gen;
+END_RCPP
+}
+// calculate_catchment
+RcppExport SEXP calculate_catchment(SEXP graph_ptr, SEXP profile_sexp, SEXP start_nodes_sexp, SEXP lim_sexp, SEXP mode_sexp, SEXP k_sexp);
+RcppExport SEXP _GeoRouteR_calculate_catchment(SEXP graph_ptrSEXP, SEXP profile_sexpSEXP, SEXP start_nodes_sexpSEXP, SEXP lim_sexpSEXP, SEXP mode_sexpSEXP, SEXP k_sexpSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type graph_ptr(graph_ptrSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type profile_sexp(profile_sexpSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type start_nodes_sexp(start_nodes_sexpSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type lim_sexp(lim_sexpSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type mode_sexp(mode_sexpSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type k_sexp(k_sexpSEXP);
+    rcpp_result_gen = Rcpp::wrap(calculate_catchment(graph_ptr, profile_sexp, start_nodes_sexp, lim_sexp, mode_sexp, k_sexp));
     return rcpp_result_gen;
 END_RCPP
 }
 // calculate_dist_mat
-RcppExport SEXP calculate_dist_mat(SEXP graph_ptr, SEXP start_nodes_sexp, SEXP end_nodes_sexp, SEXP mode_sexp);
-RcppExport SEXP _GeoRouteR_calculate_dist_mat(SEXP graph_ptrSEXP, SEXP start_nodes_sexpSEXP, SEXP end_nodes_sexpSEXP, SEXP mode_sexpSEXP) {
+RcppExport SEXP calculate_dist_mat(SEXP graph_ptr, SEXP profile_sexp, SEXP start_nodes_sexp, SEXP end_nodes_sexp, SEXP mode_sexp, SEXP engine_sexp, SEXP heuristic_sexp, SEXP paths_sexp, SEXP stats_sexp, SEXP format_sexp);
+RcppExport SEXP _GeoRouteR_calculate_dist_mat(SEXP graph_ptrSEXP, SEXP profile_sexpSEXP, SEXP start_nodes_sexpSEXP, SEXP end_nodes_sexpSEXP, SEXP mode_sexpSEXP, SEXP engine_sexpSEXP, SEXP heuristic_sexpSEXP, SEXP paths_sexpSEXP, SEXP stats_sexpSEXP, SEXP format_sexpSEXP) {
+BEGIN_RCPP
+    Rcpp::RObject rcpp_result_gen;
+    Rcpp::RNGScope rcpp_rngScope_gen;
+    Rcpp::traits::input_parameter< SEXP >::type graph_ptr(graph_ptrSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type profile_sexp(profile_sexpSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type start_nodes_sexp(start_nodes_sexpSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type end_nodes_sexp(end_nodes_sexpSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type mode_sexp(mode_sexpSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type engine_sexp(engine_sexpSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type heuristic_sexp(heuristic_sexpSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type paths_sexp(paths_sexpSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type stats_sexp(stats_sexpSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type format_sexp(format_sexpSEXP);
+    rcpp_result_gen = Rcpp::wrap(calculate_dist_mat(graph_ptr, profile_sexp, start_nodes_sexp, end_nodes_sexp, mode_sexp, engine_sexp, heuristic_sexp, paths_sexp, stats_sexp, format_sexp));
+    return rcpp_result_gen;
+END_RCPP
+}
+// calculate_pairwise
+RcppExport SEXP calculate_pairwise(SEXP graph_ptr, SEXP profile_sexp, SEXP start_nodes_sexp, SEXP end_nodes_sexp, SEXP mode_sexp, SEXP engine_sexp);
+RcppExport SEXP _GeoRouteR_calculate_pairwise(SEXP graph_ptrSEXP, SEXP profile_sexpSEXP, SEXP start_nodes_sexpSEXP, SEXP end_nodes_sexpSEXP, SEXP mode_sexpSEXP, SEXP engine_sexpSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
     Rcpp::traits::input_parameter< SEXP >::type graph_ptr(graph_ptrSEXP);
+    Rcpp::traits::input_parameter< SEXP >::type profile_sexp(profile_sexpSEXP);
     Rcpp::traits::input_parameter< SEXP >::type start_nodes_sexp(start_nodes_sexpSEXP);
     Rcpp::traits::input_parameter< SEXP >::type end_nodes_sexp(end_nodes_sexpSEXP);
     Rcpp::traits::input_parameter< SEXP >::type mode_sexp(mode_sexpSEXP);
-    rcpp_result_gen = Rcpp::wrap(calculate_dist_mat(graph_ptr, start_nodes_sexp, end_nodes_sexp, mode_sexp));
+    Rcpp::traits::input_parameter< SEXP >::type engine_sexp(engine_sexpSEXP);
+    rcpp_result_gen = Rcpp::wrap(calculate_pairwise(graph_ptr, profile_sexp, start_nodes_sexp, end_nodes_sexp, mode_sexp, engine_sexp));
     return rcpp_result_gen;
 END_RCPP
 }
@@ -126,15 +276,26 @@ END_RCPP
 RcppExport SEXP _rcpp_module_boot_graph_module();
 
 static const R_CallMethodDef CallEntries[] = {
-    {"_GeoRouteR_graph_create", (DL_FUNC) &_GeoRouteR_graph_create, 9},
-    {"_GeoRouteR_graph_edges", (DL_FUNC) &_GeoRouteR_graph_edges, 1},
-    {"_GeoRouteR_graph_nodes", (DL_FUNC) &_GeoRouteR_graph_nodes, 1},
+    {"_GeoRouteR_graph_create", (DL_FUNC) &_GeoRouteR_graph_create, 11},
+    {"_GeoRouteR_graph_edges", (DL_FUNC) &_GeoRouteR_graph_edges, 2},
+    {"_GeoRouteR_graph_nodes", (DL_FUNC) &_GeoRouteR_graph_nodes, 2},
     {"_GeoRouteR_graph_node_dict", (DL_FUNC) &_GeoRouteR_graph_node_dict, 1},
+    {"_GeoRouteR_graph_edge_count", (DL_FUNC) &_GeoRouteR_graph_edge_count, 1},
     {"_GeoRouteR_graph_crs", (DL_FUNC) &_GeoRouteR_graph_crs, 1},
     {"_GeoRouteR_graph_profile", (DL_FUNC) &_GeoRouteR_graph_profile, 1},
     {"_GeoRouteR_graph_activate_routing_profile", (DL_FUNC) &_GeoRouteR_graph_activate_routing_profile, 2},
-    {"_GeoRouteR_calculate_isochrone", (DL_FUNC) &_GeoRouteR_calculate_isochrone, 3},
-    {"_GeoRouteR_calculate_dist_mat", (DL_FUNC) &_GeoRouteR_calculate_dist_mat, 4},
+    {"_GeoRouteR_graph_save", (DL_FUNC) &_GeoRouteR_graph_save, 2},
+    {"_GeoRouteR_graph_update_edge_speeds", (DL_FUNC) &_GeoRouteR_graph_update_edge_speeds, 3},
+    {"_GeoRouteR_graph_prepare_customizable_ch", (DL_FUNC) &_GeoRouteR_graph_prepare_customizable_ch, 2},
+    {"_GeoRouteR_graph_set_tree_cache", (DL_FUNC) &_GeoRouteR_graph_set_tree_cache, 2},
+    {"_GeoRouteR_graph_set_search_heap", (DL_FUNC) &_GeoRouteR_graph_set_search_heap, 2},
+    {"_GeoRouteR_graph_tree_cache_stats", (DL_FUNC) &_GeoRouteR_graph_tree_cache_stats, 1},
+    {"_GeoRouteR_graph_load", (DL_FUNC) &_GeoRouteR_graph_load, 1},
+    {"_GeoRouteR_graph_snap", (DL_FUNC) &_GeoRouteR_graph_snap, 5},
+    {"_GeoRouteR_calculate_isochrone", (DL_FUNC) &_GeoRouteR_calculate_isochrone, 7},
+    {"_GeoRouteR_calculate_catchment", (DL_FUNC) &_GeoRouteR_calculate_catchment, 6},
+    {"_GeoRouteR_calculate_dist_mat", (DL_FUNC) &_GeoRouteR_calculate_dist_mat, 10},
+    {"_GeoRouteR_calculate_pairwise", (DL_FUNC) &_GeoRouteR_calculate_pairwise, 6},
     {"_rcpp_module_boot_graph_module", (DL_FUNC) &_rcpp_module_boot_graph_module, 0},
     {NULL, NULL, 0}
 };
@@ -2,40 +2,293 @@
 #include "graph.h"
 #include "isochrone.h"
 #include "dist_mat.h"
+#include "landmarks.h"
+#include "spatial_index.h"
+#include "id_map.h"
+#include "tree_cache.h"
+#include "search_workspace.h"
+#include <unordered_map>
+#include <cstring>
+#include <limits>
+
+// [[Rcpp::depends(RcppParallel)]]
+#include <RcppParallel.h>
 
 using namespace Rcpp;
 
 // Declare Rcpp pointer class
 RCPP_EXPOSED_CLASS_NODECL(Graph)
   
-// Graph class constructor wrapper
+namespace {
+
+// Node ids are keyed without copying strings: character ids by the address of
+// their CHARSXP, which R's global string cache makes unique per string, and
+// numeric ids by the bits of their value
+std::uint64_t string_key(SEXP name) {
+  return static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(name));
+}
+
+std::uint64_t number_key(double name) {
+  name += 0.0; // -0 and 0 are the same id
+  std::uint64_t key;
+  std::memcpy(&key, &name, sizeof(key));
+  return key;
+}
+
+// Read-only view of a node id vector (character, integer or double)
+struct NodeNames {
+  explicit NodeNames(SEXP names)
+    : strings(nullptr), integers(nullptr), numbers(nullptr), size(XLENGTH(names)) {
+    switch (TYPEOF(names)) {
+    case STRSXP:
+      strings = STRING_PTR_RO(names);
+      break;
+    case INTSXP:
+      integers = INTEGER(names);
+      break;
+    case REALSXP:
+      numbers = REAL(names);
+      break;
+    default:
+      throw std::runtime_error("Node ids must be character or numeric.");
+    }
+  }
+  
+  std::uint64_t key(std::size_t i) const {
+    if (strings) return string_key(strings[i]);
+    if (integers) return number_key(integers[i]);
+    return number_key(numbers[i]);
+  }
+  
+  const SEXP* strings;
+  const int* integers;
+  const double* numbers;
+  std::size_t size;
+};
+
+// RcppParallel worker mapping edge endpoints to node ids and converting the
+// edge attributes. Oneway values are matched by the address of their CHARSXP;
+// endpoints and oneway values that miss are resolved afterwards on the main thread.
+class EdgeArraysWorker : public RcppParallel::Worker {
+public:
+  EdgeArraysWorker(const IdMap& node_ids, const NodeNames& from, const NodeNames& to,
+                   const double* speed, const double* length, const SEXP* oneway,
+                   const SEXP* oneway_names, Graph::Arrays& arrays)
+    : node_ids_(node_ids), from_(from), to_(to), speed_(speed), length_(length),
+      oneway_(oneway), oneway_names_(oneway_names), arrays_(arrays) {}
+  
+  void operator()(std::size_t begin, std::size_t end) {
+    for (std::size_t i = begin; i < end; ++i) {
+      arrays_.edge_from[i] = node_ids_.find(from_.key(i));
+      arrays_.edge_to[i] = node_ids_.find(to_.key(i));
+      arrays_.edge_speed[i] = static_cast<Graph::Weight>(speed_[i]);
+      arrays_.edge_length[i] = static_cast<Graph::Weight>(length_[i]);
+      arrays_.edge_oneway[i] = ONEWAY_UNMATCHED;
+      for (int code = 0; code < ONEWAY_CODE_COUNT; ++code) {
+        if (oneway_[i] == oneway_names_[code]) {
+          arrays_.edge_oneway[i] = static_cast<Graph::Oneway>(code);
+          break;
+        }
+      }
+    }
+  }
+  
+  static const int ONEWAY_CODE_COUNT = 5;
+  static const Graph::Oneway ONEWAY_UNMATCHED = static_cast<Graph::Oneway>(255);
+  
+private:
+  const IdMap& node_ids_;
+  const NodeNames& from_;
+  const NodeNames& to_;
+  const double* speed_;
+  const double* length_;
+  const SEXP* oneway_;
+  const SEXP* oneway_names_;
+  Graph::Arrays& arrays_;
+};
+
+// Node id of a name whose CHARSXP was not found, e.g. the same text in another
+// encoding; the UTF-8 lookup table is built on the first miss
+int find_node_by_text(SEXP name, SEXP node_name, std::unordered_map<std::string, int>& by_text) {
+  if (by_text.empty()) {
+    R_xlen_t n = XLENGTH(node_name);
+    by_text.reserve(n);
+    for (R_xlen_t i = 0; i < n; ++i) {
+      by_text.emplace(Rf_translateCharUTF8(STRING_ELT(node_name, i)), static_cast<int>(i));
+    }
+  }
+  auto it = by_text.find(Rf_translateCharUTF8(name));
+  return it == by_text.end() ? -1 : it->second;
+}
+
+// Metric of a mode argument: "time", "distance", or the weights c(time, distance) of a mix
+Metric as_metric(SEXP mode) {
+  if (TYPEOF(mode) == STRSXP) {
+    return Metric(as<std::string>(mode));
+  }
+  NumericVector weights(mode);
+  if (weights.size() != 2) {
+    throw std::runtime_error("Metric weights must be a time and a distance weight.");
+  }
+  return Metric(weights[0], weights[1]);
+}
+
+// Search statistics with one row per start node; counters are doubles, as
+// they may exceed the range of R integers
+DataFrame query_stats_frame(const std::vector<QueryStats>& stats) {
+  size_t n = stats.size();
+  IntegerVector start(n), thread(n);
+  NumericVector settled(n), relaxed(n), pushes(n), stale(n), seconds(n);
+  for (size_t i = 0; i < n; ++i) {
+    start[i] = stats[i].start;
+    settled[i] = static_cast<double>(stats[i].settled);
+    relaxed[i] = static_cast<double>(stats[i].relaxed);
+    pushes[i] = static_cast<double>(stats[i].pushes);
+    stale[i] = static_cast<double>(stats[i].stale);
+    seconds[i] = stats[i].seconds;
+    thread[i] = stats[i].thread;
+  }
+  return DataFrame::create(_["start"] = start,
+                           _["settled"] = settled,
+                           _["relaxed"] = relaxed,
+                           _["pushes"] = pushes,
+                           _["stale"] = stale,
+                           _["seconds"] = seconds,
+                           _["thread"] = thread);
+}
+
+void check_interrupt(void*) {
+  R_CheckUserInterrupt();
+}
+
+// Monitor of the parallel loops of a query, polled on the main thread: checks
+// for a user interrupt (without the longjmp escaping into C++) and, with
+// option GeoRouteR.progress, prints the share of finished start nodes
+class RMonitor : public parallel::Monitor {
+public:
+  RMonitor() : progress_(false), printed_(false) {
+    SEXP progress = Rf_GetOption1(Rf_install("GeoRouteR.progress"));
+    progress_ = !Rf_isNull(progress) && Rf_asLogical(progress) == TRUE;
+    schedule_.monitor = this;
+    SEXP grain = Rf_GetOption1(Rf_install("GeoRouteR.grain_size"));
+    if (!Rf_isNull(grain)) {
+      int value = Rf_asInteger(grain);
+      if (value == NA_INTEGER || value < 1) {
+        throw std::runtime_error("Option GeoRouteR.grain_size must be a positive integer.");
+      }
+      schedule_.grain = static_cast<std::size_t>(value);
+    }
+  }
+  
+  ~RMonitor() {
+    if (printed_) {
+      REprintf("\n");
+    }
+  }
+  
+  bool poll(std::size_t done, std::size_t total) {
+    if (progress_) {
+      REprintf("\r%3.0f%%", 100.0 * done / total);
+      printed_ = true;
+    }
+    return R_ToplevelExec(check_interrupt, nullptr) == TRUE;
+  }
+  
+  const parallel::Schedule& schedule() const { return schedule_; }
+  
+private:
+  parallel::Schedule schedule_;
+  bool progress_;
+  bool printed_;
+};
+
+}
+
+// Graph class constructor wrapper. Node ids may be character or numeric; the
+// input vectors are read in place and edges are mapped in parallel.
 // [[Rcpp::export]]
-RcppExport SEXP graph_create(SEXP edge_from, SEXP edge_to, SEXP edge_speed, SEXP edge_length, SEXP edge_oneway, SEXP node_name, SEXP node_x, SEXP node_y, SEXP crs) {
+RcppExport SEXP graph_create(SEXP edge_from, SEXP edge_to, SEXP edge_speed, SEXP edge_length, SEXP edge_oneway, SEXP node_name, SEXP node_x, SEXP node_y, SEXP crs, SEXP node_order,
+                             SEXP directed) {
     BEGIN_RCPP
-    CharacterVector edge_from_str(edge_from), edge_to_str(edge_to), node_name_str(node_name), edge_oneway_str(edge_oneway);
     NumericVector edge_speed_num(edge_speed), edge_length_num(edge_length), node_x_num(node_x), node_y_num(node_y);
+    CharacterVector edge_oneway_str(edge_oneway);
     std::string crs_str = as<std::string>(crs);
+    Graph::NodeOrder order = Graph::parse_node_order(as<std::string>(node_order));
+    
+    NodeNames names(node_name), from(edge_from), to(edge_to);
+    if ((names.strings != nullptr) != (from.strings != nullptr) || (names.strings != nullptr) != (to.strings != nullptr)) {
+      throw std::runtime_error("Node ids of edges and nodes must be both character or both numeric.");
+    }
+    size_t n = names.size;
+    size_t m = from.size;
+    if (to.size != m || static_cast<size_t>(edge_speed_num.size()) != m || static_cast<size_t>(edge_length_num.size()) != m ||
+        static_cast<size_t>(edge_oneway_str.size()) != m || static_cast<size_t>(node_x_num.size()) != n ||
+        static_cast<size_t>(node_y_num.size()) != n) {
+      throw std::runtime_error("Graph arrays have inconsistent lengths.");
+    }
+    
+    // Node ids in input order
+    IdMap node_ids(n);
+    for (size_t i = 0; i < n; ++i) {
+      if (!node_ids.insert(names.key(i), static_cast<int>(i))) {
+        throw std::runtime_error("Node ids must be unique.");
+      }
+    }
+    
+    // Edges
+    Graph::Arrays arrays;
+    arrays.edge_from.resize(m);
+    arrays.edge_to.resize(m);
+    arrays.edge_speed.resize(m);
+    arrays.edge_length.resize(m);
+    arrays.edge_oneway.resize(m);
+    CharacterVector oneway_names(EdgeArraysWorker::ONEWAY_CODE_COUNT);
+    for (int code = 0; code < EdgeArraysWorker::ONEWAY_CODE_COUNT; ++code) {
+      oneway_names[code] = Graph::oneway_name(static_cast<Graph::Oneway>(code));
+    }
+    const SEXP* oneway = STRING_PTR_RO(edge_oneway_str);
+    EdgeArraysWorker worker(node_ids, from, to, REAL(edge_speed_num), REAL(edge_length_num),
+                            oneway, STRING_PTR_RO(oneway_names), arrays);
+    RcppParallel::parallelFor(0, m, worker);
+    
+    std::unordered_map<std::string, int> by_text;
+    for (size_t i = 0; i < m; ++i) {
+      if (arrays.edge_from[i] < 0 && names.strings) {
+        arrays.edge_from[i] = find_node_by_text(from.strings[i], node_name, by_text);
+      }
+      if (arrays.edge_to[i] < 0 && names.strings) {
+        arrays.edge_to[i] = find_node_by_text(to.strings[i], node_name, by_text);
+      }
+      if (arrays.edge_oneway[i] == EdgeArraysWorker::ONEWAY_UNMATCHED) {
+        arrays.edge_oneway[i] = Graph::parse_oneway(Rf_translateCharUTF8(oneway[i]));
+      }
+    }
     
-    std::vector<std::string> edge_from_std(edge_from_str.begin(), edge_from_str.end());
-    std::vector<std::string> edge_to_std(edge_to_str.begin(), edge_to_str.end());
-    std::vector<double> edge_speed_std(edge_speed_num.begin(), edge_speed_num.end());
-    std::vector<double> edge_length_std(edge_length_num.begin(), edge_length_num.end());
-    std::vector<std::string> node_name_std(node_name_str.begin(), node_name_str.end());
-    std::vector<std::string> edge_oneway_std(edge_oneway_str.begin(), edge_oneway_str.end());
-    std::vector<double> node_x_std(node_x_num.begin(), node_x_num.end());
-    std::vector<double> node_y_std(node_y_num.begin(), node_y_num.end());
+    // Nodes: coordinates and the name table, with numeric ids formatted as by as.character
+    arrays.node_x.assign(node_x_num.begin(), node_x_num.end());
+    arrays.node_y.assign(node_y_num.begin(), node_y_num.end());
+    CharacterVector node_name_str = names.strings ? CharacterVector(node_name) : CharacterVector(Rf_coerceVector(node_name, STRSXP));
+    arrays.name_offsets.assign(n + 1, 0);
+    for (size_t i = 0; i < n; ++i) {
+      arrays.name_offsets[i + 1] = arrays.name_offsets[i] + std::strlen(CHAR(STRING_ELT(node_name_str, i)));
+    }
+    arrays.name_chars.resize(arrays.name_offsets[n]);
+    for (size_t i = 0; i < n; ++i) {
+      std::memcpy(arrays.name_chars.data() + arrays.name_offsets[i], CHAR(STRING_ELT(node_name_str, i)),
+                  arrays.name_offsets[i + 1] - arrays.name_offsets[i]);
+    }
     
-    XPtr<Graph> ptr(new Graph(edge_from_std, edge_to_std, edge_speed_std, edge_length_std, edge_oneway_std, node_name_std, node_x_std, node_y_std, crs_str));
+    XPtr<Graph> ptr(new Graph(std::move(arrays), crs_str, order, as<bool>(directed)));
     return ptr;
     END_RCPP
   }
 
 // Getters
 // [[Rcpp::export]]
-RcppExport SEXP graph_edges(SEXP p) {
+RcppExport SEXP graph_edges(SEXP p, SEXP profile) {
   BEGIN_RCPP
   XPtr<Graph> ptr(p);
-  const auto& edges = ptr->edges();
+  const auto edges = ptr->edges(as<int>(profile));
   
   size_t n = edges.size();
   IntegerVector from(n);
@@ -51,7 +304,7 @@ RcppExport SEXP graph_edges(SEXP p) {
     cost[i] = edges[i].cost;
     speed[i] = edges[i].speed;
     length[i] = edges[i].length;
-    oneway[i] = edges[i].oneway;
+    oneway[i] = Graph::oneway_name(edges[i].oneway);
   }
   
   return DataFrame::create(_["from"] = from,
@@ -64,10 +317,10 @@ RcppExport SEXP graph_edges(SEXP p) {
 }
 
 // [[Rcpp::export]]
-RcppExport SEXP graph_nodes(SEXP p) {
+RcppExport SEXP graph_nodes(SEXP p, SEXP profile) {
   BEGIN_RCPP
   XPtr<Graph> ptr(p);
-  const auto& nodes = ptr->nodes();
+  const auto nodes = ptr->nodes(as<int>(profile));
   
   size_t n = nodes.size();
   IntegerVector id(n);
@@ -90,17 +343,13 @@ RcppExport SEXP graph_nodes(SEXP p) {
 RcppExport SEXP graph_node_dict(SEXP p) {
   BEGIN_RCPP
   XPtr<Graph> ptr(p);
-  const auto& node_dict = ptr->node_dict();
-  
-  size_t n = node_dict.size();
+  int n = ptr->node_count();
   IntegerVector key(n);
   CharacterVector value(n);
   
-  size_t i = 0;
-  for (const auto& kv : node_dict) {
-    key[i] = kv.first;
-    value[i] = kv.second;
-    i++;
+  for (int i = 0; i < n; ++i) {
+    key[i] = i;
+    value[i] = ptr->node_name(i);
   }
   
   return DataFrame::create(_["node"] = value,
@@ -108,6 +357,14 @@ RcppExport SEXP graph_node_dict(SEXP p) {
   END_RCPP
 }
 
+// [[Rcpp::export]]
+RcppExport SEXP graph_edge_count(SEXP p) {
+  BEGIN_RCPP
+  XPtr<Graph> ptr(p);
+  return wrap(static_cast<double>(ptr->edge_count()));
+  END_RCPP
+}
+
 // [[Rcpp::export]]
 RcppExport SEXP graph_crs(SEXP p) {
   BEGIN_RCPP
@@ -134,6 +391,110 @@ void graph_activate_routing_profile(SEXP p, SEXP profile) {
   VOID_END_RCPP
 }
 
+// [[Rcpp::export]]
+void graph_save(SEXP p, SEXP path) {
+  BEGIN_RCPP
+  XPtr<Graph> ptr(p);
+  ptr->save(as<std::string>(path));
+  VOID_END_RCPP
+}
+
+// [[Rcpp::export]]
+void graph_update_edge_speeds(SEXP p, SEXP edge_ids_sexp, SEXP speeds_sexp) {
+  BEGIN_RCPP
+  XPtr<Graph> ptr(p);
+  std::vector<int> edge_ids = as<std::vector<int>>(edge_ids_sexp);
+  std::vector<double> speeds = as<std::vector<double>>(speeds_sexp);
+  ptr->update_edge_speeds(edge_ids, speeds);
+  VOID_END_RCPP
+}
+
+// [[Rcpp::export]]
+void graph_prepare_customizable_ch(SEXP p, SEXP profile) {
+  BEGIN_RCPP
+  XPtr<Graph> ptr(p);
+  int routing_profile = as<int>(profile);
+  ptr->prepare_contraction_hierarchy(routing_profile, "time", true);
+  VOID_END_RCPP
+}
+
+// [[Rcpp::export]]
+void graph_set_tree_cache(SEXP p, SEXP capacity_sexp) {
+  BEGIN_RCPP
+  XPtr<Graph> ptr(p);
+  ptr->set_tree_cache(static_cast<std::size_t>(as<double>(capacity_sexp)));
+  VOID_END_RCPP
+}
+
+// [[Rcpp::export]]
+void graph_set_search_heap(SEXP p, SEXP heap) {
+  BEGIN_RCPP
+  XPtr<Graph> ptr(p);
+  ptr->workspaces().set_dijkstra_heap(SearchWorkspace::parse_heap(as<std::string>(heap)));
+  VOID_END_RCPP
+}
+
+// [[Rcpp::export]]
+RcppExport SEXP graph_tree_cache_stats(SEXP p) {
+  BEGIN_RCPP
+  XPtr<Graph> ptr(p);
+  TreeCache::Stats stats = {0, 0, 0, 0, 0, 0, 0};
+  if (ptr->tree_cache()) {
+    stats = ptr->tree_cache()->stats();
+  }
+  
+  // Counters are doubles, as they may exceed the range of R integers
+  return List::create(_["hits"] = static_cast<double>(stats.hits),
+                      _["extensions"] = static_cast<double>(stats.extensions),
+                      _["misses"] = static_cast<double>(stats.misses),
+                      _["evictions"] = static_cast<double>(stats.evictions),
+                      _["entries"] = static_cast<double>(stats.entries),
+                      _["bytes"] = static_cast<double>(stats.bytes),
+                      _["capacity"] = static_cast<double>(stats.capacity));
+  END_RCPP
+}
+
+// [[Rcpp::export]]
+RcppExport SEXP graph_load(SEXP path) {
+  BEGIN_RCPP
+  std::unique_ptr<Graph> graph = Graph::load(as<std::string>(path));
+  XPtr<Graph> ptr(graph.release());
+  return ptr;
+  END_RCPP
+}
+
+// [[Rcpp::export]]
+RcppExport SEXP graph_snap(SEXP p, SEXP profile, SEXP x_sexp, SEXP y_sexp, SEXP max_dist_sexp) {
+  BEGIN_RCPP
+  XPtr<Graph> ptr(p);
+  int routing_profile = as<int>(profile);
+  std::vector<double> x = as<std::vector<double>>(x_sexp);
+  std::vector<double> y = as<std::vector<double>>(y_sexp);
+  double max_dist = as<double>(max_dist_sexp);
+  if (x.size() != y.size()) {
+    throw std::runtime_error("x and y must have the same length.");
+  }
+  
+  ptr->prepare_spatial_index(routing_profile);
+  
+  size_t n = x.size();
+  IntegerVector id(n);
+  NumericVector dist(n);
+  parallelSnap(ptr->spatial_index(routing_profile), x, y, max_dist, INTEGER(id), REAL(dist));
+  
+  // Points without a node within reach get NA
+  for (size_t i = 0; i < n; ++i) {
+    if (id[i] < 0) {
+      id[i] = NA_INTEGER;
+      dist[i] = NA_REAL;
+    }
+  }
+  
+  return DataFrame::create(_["id"] = id,
+                           _["dist"] = dist);
+  END_RCPP
+}
+
 RCPP_MODULE(graph_module) {
   using namespace Rcpp;
   // Getters
@@ -141,81 +502,217 @@ RCPP_MODULE(graph_module) {
   function("graph_edges", &graph_edges);
   function("graph_nodes", &graph_nodes);
   function("graph_node_dict", &graph_node_dict);
+  function("graph_edge_count", &graph_edge_count);
   function("graph_crs", &graph_crs);
   function("graph_profile", &graph_profile);
   //Methods
   function("graph_activate_routing_profile", &graph_activate_routing_profile);
+  function("graph_save", &graph_save);
+  function("graph_update_edge_speeds", &graph_update_edge_speeds);
+  function("graph_prepare_customizable_ch", &graph_prepare_customizable_ch);
+  function("graph_set_tree_cache", &graph_set_tree_cache);
+  function("graph_set_search_heap", &graph_set_search_heap);
+  function("graph_tree_cache_stats", &graph_tree_cache_stats);
+  function("graph_load", &graph_load);
+  function("graph_snap", &graph_snap);
 }
 
 // Methods
 // [[Rcpp::export]]
-RcppExport SEXP calculate_isochrone(SEXP graph_ptr, SEXP start_nodes_sexp, SEXP lim_sexp) {
+RcppExport SEXP calculate_isochrone(SEXP graph_ptr, SEXP profile_sexp, SEXP start_nodes_sexp, SEXP lim_sexp, SEXP mode_sexp, SEXP engine_sexp,
+                                    SEXP stats_sexp) {
   BEGIN_RCPP
   XPtr<Graph> graph(graph_ptr);
+  int profile = Rcpp::as<int>(profile_sexp);
   std::vector<int> start_nodes = Rcpp::as<std::vector<int>>(start_nodes_sexp);
   std::vector<double> lim = Rcpp::as<std::vector<double>>(lim_sexp);
+  Metric metric = as_metric(mode_sexp);
+  std::string engine = Rcpp::as<std::string>(engine_sexp);
+  bool with_stats = Rcpp::as<bool>(stats_sexp);
   
-  auto all_isochrones = parallelCalculateIsochrone(*graph, start_nodes, lim);
+  if (engine == "phast") {
+    graph->prepare_contraction_hierarchy(profile, metric.mode());
+  }
+  
+  std::vector<QueryStats> stats;
+  RMonitor monitor;
+  std::vector<IsochroneColumns> chunks = parallelCalculateIsochrone(*graph, profile, start_nodes, lim, metric, engine,
+                                                                    with_stats ? &stats : nullptr, monitor.schedule());
   
   size_t total_size = 0;
-  for (const auto& isochrones : all_isochrones) {
-    total_size += isochrones.size();
+  for (const auto& chunk : chunks) {
+    total_size += chunk.size();
   }
   
+  // The chunks are already in row order; copy them into the columns and free
+  // each one right after
   IntegerVector start(total_size);
   IntegerVector end(total_size);
   NumericVector cost(total_size);
   NumericVector threshold(total_size);
   
   size_t index = 0;
-  for (const auto& isochrones : all_isochrones) {
-    for (const auto& iso : isochrones) {
-      start[index] = std::get<0>(iso);
-      end[index] = std::get<1>(iso);
-      cost[index] = std::get<2>(iso);
-      threshold[index] = std::get<3>(iso);
-      ++index;
-    }
+  for (auto& chunk : chunks) {
+    std::copy(chunk.start.begin(), chunk.start.end(), start.begin() + index);
+    std::copy(chunk.end.begin(), chunk.end.end(), end.begin() + index);
+    std::copy(chunk.cost.begin(), chunk.cost.end(), cost.begin() + index);
+    std::copy(chunk.threshold.begin(), chunk.threshold.end(), threshold.begin() + index);
+    index += chunk.size();
+    chunk = IsochroneColumns();
   }
   
-  return DataFrame::create(_["start"] = start,
-                           _["end"] = end,
-                           _["cost"] = cost,
-                           _["threshold"] = threshold);
+  DataFrame result = DataFrame::create(_["start"] = start,
+                                       _["end"] = end,
+                                       _["cost"] = cost,
+                                       _["threshold"] = threshold);
+  if (with_stats) {
+    result.attr("stats") = query_stats_frame(stats);
+  }
+  return result;
+  END_RCPP
+}
+
+// [[Rcpp::export]]
+RcppExport SEXP calculate_catchment(SEXP graph_ptr, SEXP profile_sexp, SEXP start_nodes_sexp, SEXP lim_sexp, SEXP mode_sexp, SEXP k_sexp) {
+  BEGIN_RCPP
+  XPtr<Graph> graph(graph_ptr);
+  int profile = Rcpp::as<int>(profile_sexp);
+  std::vector<int> start_nodes = Rcpp::as<std::vector<int>>(start_nodes_sexp);
+  std::vector<double> lim = Rcpp::as<std::vector<double>>(lim_sexp);
+  Metric metric = as_metric(mode_sexp);
+  int k = Rcpp::as<int>(k_sexp);
+  
+  CatchmentColumns rows;
+  {
+    WorkspacePool::Lease workspace(graph->workspaces());
+    _calculateCatchment(*graph, profile, start_nodes, lim, metric, k, *workspace, rows);
+  }
+  
+  return DataFrame::create(_["start"] = wrap(rows.start),
+                           _["end"] = wrap(rows.end),
+                           _["rank"] = wrap(rows.rank),
+                           _["cost"] = wrap(rows.cost),
+                           _["threshold"] = wrap(rows.threshold));
   END_RCPP
 }
 
 // [[Rcpp::export]]
-RcppExport SEXP calculate_dist_mat(SEXP graph_ptr, SEXP start_nodes_sexp, SEXP end_nodes_sexp, SEXP mode_sexp) {
+RcppExport SEXP calculate_dist_mat(SEXP graph_ptr, SEXP profile_sexp, SEXP start_nodes_sexp, SEXP end_nodes_sexp, SEXP mode_sexp, SEXP engine_sexp, SEXP heuristic_sexp,
+                                   SEXP paths_sexp, SEXP stats_sexp, SEXP format_sexp) {
   BEGIN_RCPP
   XPtr<Graph> graph(graph_ptr);
+  int profile = Rcpp::as<int>(profile_sexp);
   std::vector<int> start_nodes = Rcpp::as<std::vector<int>>(start_nodes_sexp);
   std::vector<int> end_nodes = Rcpp::as<std::vector<int>>(end_nodes_sexp);
-  std::string mode = Rcpp::as<std::string>(mode_sexp);
+  Metric metric = as_metric(mode_sexp);
+  std::string engine = Rcpp::as<std::string>(engine_sexp);
+  std::string heuristic = Rcpp::as<std::string>(heuristic_sexp);
+  bool with_paths = Rcpp::as<bool>(paths_sexp);
+  bool with_stats = Rcpp::as<bool>(stats_sexp);
+  std::string format = Rcpp::as<std::string>(format_sexp);
+  if (format != "data.frame" && format != "matrix" && format != "seconds") {
+    throw std::runtime_error("Invalid distance matrix format.");
+  }
+  if (with_paths && format != "data.frame") {
+    throw std::runtime_error("Paths are only available in the \"data.frame\" format.");
+  }
   
-  auto all_paths = parallelCalculateDistMat(*graph, start_nodes, end_nodes, mode);
+  if (engine == "ch") {
+    graph->prepare_contraction_hierarchy(profile, metric.mode());
+  } else if (engine == "astar" && heuristic == "alt") {
+    graph->prepare_landmarks(profile, metric.mode(), DEFAULT_LANDMARK_COUNT);
+  }
   
-  size_t total_size = 0;
-  for (const auto& paths : all_paths) {
-    total_size += paths.size();
+  // The workers write their cells straight into the columns or the matrix;
+  // matrices hold NA for unreachable end nodes, and format "seconds" holds
+  // the travel time in minutes as whole seconds
+  size_t total_size = start_nodes.size() * end_nodes.size();
+  IntegerVector start, end;
+  NumericVector cost;
+  RObject result;
+  DistMatOutput out;
+  if (format == "matrix") {
+    NumericMatrix matrix(static_cast<int>(start_nodes.size()), static_cast<int>(end_nodes.size()));
+    out = DistMatOutput::matrix(REAL(matrix), start_nodes.size(), NA_REAL);
+    result = matrix;
+  } else if (format == "seconds") {
+    IntegerMatrix matrix(static_cast<int>(start_nodes.size()), static_cast<int>(end_nodes.size()));
+    out = DistMatOutput::integer_matrix(INTEGER(matrix), start_nodes.size(), 60.0, NA_INTEGER);
+    result = matrix;
+  } else {
+    start = IntegerVector(total_size);
+    end = IntegerVector(total_size);
+    cost = NumericVector(total_size);
+    out = DistMatOutput::columns(INTEGER(start), INTEGER(end), REAL(cost), end_nodes.size());
   }
   
-  IntegerVector start(total_size);
-  IntegerVector end(total_size);
-  NumericVector cost(total_size);
+  DistMatPaths paths;
+  std::vector<QueryStats> stats;
+  RMonitor monitor;
+  parallelCalculateDistMat(*graph, profile, start_nodes, end_nodes, metric, engine, heuristic, out, with_paths ? &paths : nullptr,
+                           with_stats ? &stats : nullptr, monitor.schedule());
   
-  size_t index = 0;
-  for (const auto& paths : all_paths) {
-    for (const auto& path : paths) {
-      start[index] = std::get<0>(path);
-      end[index] = std::get<1>(path);
-      cost[index] = std::get<2>(path);
-      ++index;
+  if (format == "data.frame") {
+    result = DataFrame::create(_["start"] = start,
+                               _["end"] = end,
+                               _["cost"] = cost);
+  }
+  
+  // Routes in flat form: offsets per row into the concatenated node and edge ids
+  if (with_paths) {
+    size_t path_size = paths.size();
+    if (path_size > static_cast<size_t>(std::numeric_limits<int>::max())) {
+      throw std::runtime_error("The routes are too long to be returned.");
     }
+    IntegerVector offsets(total_size + 1);
+    IntegerVector node(path_size);
+    IntegerVector edge(path_size);
+    paths.flatten(INTEGER(offsets), INTEGER(node), INTEGER(edge));
+    result.attr("paths") = List::create(_["offsets"] = offsets,
+                                        _["node"] = node,
+                                        _["edge"] = edge);
+  }
+  if (with_stats) {
+    result.attr("stats") = query_stats_frame(stats);
+  }
+  
+  return result;
+  END_RCPP
+}
+
+
+// [[Rcpp::export]]
+RcppExport SEXP calculate_pairwise(SEXP graph_ptr, SEXP profile_sexp, SEXP start_nodes_sexp, SEXP end_nodes_sexp, SEXP mode_sexp, SEXP engine_sexp) {
+  BEGIN_RCPP
+  XPtr<Graph> graph(graph_ptr);
+  int profile = Rcpp::as<int>(profile_sexp);
+  std::vector<int> start_nodes = Rcpp::as<std::vector<int>>(start_nodes_sexp);
+  std::vector<int> end_nodes = Rcpp::as<std::vector<int>>(end_nodes_sexp);
+  Metric metric = as_metric(mode_sexp);
+  std::string engine = Rcpp::as<std::string>(engine_sexp);
+  
+  if (engine == "ch") {
+    graph->prepare_contraction_hierarchy(profile, metric.mode());
+  } else {
+    graph->prepare_reverse_adjacency(profile);
+  }
+  
+  auto paths = parallelCalculatePairwise(*graph, profile, start_nodes, end_nodes, metric, engine);
+  
+  // Keep one row per pair; unreachable pairs get an NA cost
+  size_t n = paths.size();
+  IntegerVector start(n);
+  IntegerVector end(n);
+  NumericVector cost(n);
+  
+  for (size_t i = 0; i < n; ++i) {
+    start[i] = start_nodes[i];
+    end[i] = end_nodes[i];
+    cost[i] = std::get<0>(paths[i]) == -1 ? NA_REAL : std::get<2>(paths[i]);
   }
   
   return DataFrame::create(_["start"] = start,
                            _["end"] = end,
                            _["cost"] = cost);
   END_RCPP
-}
+}
\ No newline at end of file
@@ -0,0 +1,53 @@
+#ifndef BUFFER_H
+#define BUFFER_H
+
+#include <vector>
+#include <memory>
+#include <cstddef>
+#include <utility>
+
+// Contiguous array. The elements either live in a vector owned by the buffer
+// or in external memory (such as a memory-mapped graph file) that is kept
+// alive by the owner handle. Copies share the same elements until one of them
+// is written through mutable_data().
+template <typename T>
+class Buffer {
+public:
+  Buffer() : data_(nullptr), size_(0), owned_(nullptr) {}
+
+  // Take ownership of the elements of a vector
+  Buffer(std::vector<T>&& values) {
+    std::shared_ptr<std::vector<T>> owned = std::make_shared<std::vector<T>>(std::move(values));
+    data_ = owned->data();
+    size_ = owned->size();
+    owner_ = owned;
+    owned_ = owned.get();
+  }
+
+  // View size elements at data, kept alive by owner
+  Buffer(const T* data, std::size_t size, std::shared_ptr<const void> owner)
+    : owner_(std::move(owner)), data_(data), size_(size), owned_(nullptr) {}
+
+  const T& operator[](std::size_t i) const { return data_[i]; }
+  const T* data() const { return data_; }
+  std::size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  const T* begin() const { return data_; }
+  const T* end() const { return data_ + size_; }
+
+  // Writable elements; shared or external elements are copied first
+  T* mutable_data() {
+    if (!owned_ || owner_.use_count() > 1) {
+      *this = Buffer(std::vector<T>(begin(), end()));
+    }
+    return owned_->data();
+  }
+
+private:
+  std::shared_ptr<const void> owner_;
+  const T* data_;
+  std::size_t size_;
+  std::vector<T>* owned_;
+};
+
+#endif // BUFFER_H
@@ -0,0 +1,802 @@
+#include "contraction_hierarchy.h"
+#include "parallel.h"
+#include <queue>
+#include <limits>
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+
+namespace {
+
+// Maximum number of nodes settled by a single witness search
+const int WITNESS_SETTLE_LIMIT = 100;
+
+// Arc of the remaining (not yet contracted) graph
+struct DynamicArc {
+  int node;
+  double weight;
+  int arc;
+};
+
+using NodeCostPair = std::pair<double, int>;
+
+struct Shortcut {
+  int from;
+  int to;
+  double weight;
+  int first;
+  int second;
+};
+
+// Node contraction by edge difference with lazy priority updates
+class Contractor {
+public:
+  Contractor(int node_count, std::vector<ContractionHierarchy::Arc>& arcs)
+    : out_(node_count), in_(node_count), deleted_neighbors_(node_count, 0),
+      witness_costs_(node_count, std::numeric_limits<double>::max()),
+      is_target_(node_count, false), arcs_(arcs) {}
+
+  // Insert an arc, keeping only the cheapest arc between two nodes
+  void add_arc(int from, int to, double weight, int arc_id) {
+    for (DynamicArc& out : out_[from]) {
+      if (out.node == to) {
+        if (weight < out.weight) {
+          out.weight = weight;
+          out.arc = arc_id;
+          for (DynamicArc& in : in_[to]) {
+            if (in.node == from) {
+              in.weight = weight;
+              in.arc = arc_id;
+              break;
+            }
+          }
+        }
+        return;
+      }
+    }
+    out_[from].push_back({to, weight, arc_id});
+    in_[to].push_back({from, weight, arc_id});
+  }
+
+  // Edge difference of contracting node v
+  int priority(int v) {
+    int shortcuts = static_cast<int>(find_shortcuts(v).size());
+    int removed = static_cast<int>(in_[v].size() + out_[v].size());
+    return shortcuts - removed + deleted_neighbors_[v];
+  }
+
+  // Contract node v: insert its shortcuts and report its upward arcs
+  void contract(int v, std::vector<DynamicArc>& upward_out, std::vector<DynamicArc>& upward_in) {
+    std::vector<Shortcut> shortcuts = find_shortcuts(v);
+
+    upward_out = out_[v];
+    upward_in = in_[v];
+
+    // Detach v from the remaining graph
+    for (const DynamicArc& in : in_[v]) {
+      remove_arc(out_[in.node], v);
+      deleted_neighbors_[in.node]++;
+    }
+    for (const DynamicArc& out : out_[v]) {
+      remove_arc(in_[out.node], v);
+      deleted_neighbors_[out.node]++;
+    }
+    out_[v].clear();
+    in_[v].clear();
+
+    for (const Shortcut& shortcut : shortcuts) {
+      int arc_id = static_cast<int>(arcs_.size());
+      arcs_.push_back({shortcut.from, shortcut.to, shortcut.weight, -1, shortcut.first, shortcut.second});
+      add_arc(shortcut.from, shortcut.to, shortcut.weight, arc_id);
+    }
+  }
+
+private:
+  std::vector<std::vector<DynamicArc>> out_;
+  std::vector<std::vector<DynamicArc>> in_;
+  std::vector<int> deleted_neighbors_;
+  std::vector<double> witness_costs_;
+  std::vector<int> witness_touched_;
+  std::vector<NodeCostPair> witness_heap_;
+  std::vector<bool> is_target_;
+  std::vector<ContractionHierarchy::Arc>& arcs_;
+
+  static void remove_arc(std::vector<DynamicArc>& list, int node) {
+    for (size_t i = 0; i < list.size(); ++i) {
+      if (list[i].node == node) {
+        list[i] = list.back();
+        list.pop_back();
+        return;
+      }
+    }
+  }
+
+  // Shortcuts u -> w that are needed when v is removed, i.e. where no witness
+  // path avoiding v is at most as expensive as u -> v -> w
+  std::vector<Shortcut> find_shortcuts(int v) {
+    std::vector<Shortcut> shortcuts;
+
+    for (const DynamicArc& in : in_[v]) {
+      int u = in.node;
+      double max_cost = -1.0;
+      for (const DynamicArc& out : out_[v]) {
+        if (out.node != u) {
+          max_cost = std::max(max_cost, in.weight + out.weight);
+        }
+      }
+      if (max_cost < 0.0) {
+        continue;
+      }
+
+      // Mark the out-neighbours of v as targets of the witness search
+      int targets = 0;
+      for (const DynamicArc& out : out_[v]) {
+        if (out.node != u && !is_target_[out.node]) {
+          is_target_[out.node] = true;
+          targets++;
+        }
+      }
+
+      witness_search(u, v, max_cost, targets);
+
+      for (const DynamicArc& out : out_[v]) {
+        is_target_[out.node] = false;
+      }
+
+      for (const DynamicArc& out : out_[v]) {
+        int w = out.node;
+        double via_cost = in.weight + out.weight;
+        if (w != u && witness_costs_[w] > via_cost) {
+          shortcuts.push_back({u, w, via_cost, in.arc, out.arc});
+        }
+      }
+
+      for (int node : witness_touched_) {
+        witness_costs_[node] = std::numeric_limits<double>::max();
+      }
+      witness_touched_.clear();
+    }
+
+    return shortcuts;
+  }
+
+  // Local Dijkstra from u that ignores v, bounded by cost and settled nodes.
+  // It stops early once all targets are settled.
+  void witness_search(int u, int v, double max_cost, int targets) {
+    std::greater<NodeCostPair> compare;
+    witness_heap_.clear();
+    witness_costs_[u] = 0.0;
+    witness_touched_.push_back(u);
+    witness_heap_.push_back({0.0, u});
+
+    int settled = 0;
+    while (!witness_heap_.empty()) {
+      double current_cost = witness_heap_.front().first;
+      int current_node = witness_heap_.front().second;
+      std::pop_heap(witness_heap_.begin(), witness_heap_.end(), compare);
+      witness_heap_.pop_back();
+
+      if (current_cost > witness_costs_[current_node]) {
+        continue;
+      }
+      if (current_cost > max_cost || ++settled > WITNESS_SETTLE_LIMIT) {
+        break;
+      }
+      if (is_target_[current_node] && --targets == 0) {
+        break;
+      }
+
+      for (const DynamicArc& out : out_[current_node]) {
+        if (out.node == v) {
+          continue;
+        }
+        double new_cost = current_cost + out.weight;
+        if (new_cost < witness_costs_[out.node]) {
+          if (witness_costs_[out.node] == std::numeric_limits<double>::max()) {
+            witness_touched_.push_back(out.node);
+          }
+          witness_costs_[out.node] = new_cost;
+          witness_heap_.push_back({new_cost, out.node});
+          std::push_heap(witness_heap_.begin(), witness_heap_.end(), compare);
+        }
+      }
+    }
+  }
+};
+
+// Lay out per-node arc lists as a CSR upward graph
+ContractionHierarchy::UpwardGraph make_upward_graph(const std::vector<std::vector<DynamicArc>>& lists) {
+  ContractionHierarchy::UpwardGraph upward;
+  upward.offsets.assign(lists.size() + 1, 0);
+  for (size_t u = 0; u < lists.size(); ++u) {
+    upward.offsets[u + 1] = upward.offsets[u] + static_cast<int>(lists[u].size());
+  }
+
+  for (const std::vector<DynamicArc>& list : lists) {
+    for (const DynamicArc& arc : list) {
+      upward.targets.push_back(arc.node);
+      upward.weights.push_back(arc.weight);
+      upward.arc_ids.push_back(arc.arc);
+    }
+  }
+
+  return upward;
+}
+
+// Cells of at most this many nodes are not split further
+const size_t DISSECTION_LEAF_SIZE = 4;
+
+// Nested dissection order from the node coordinates: a cell is split at the
+// median of the axis whose boundary is smaller, the nodes of that boundary
+// (the separator) take the highest ranks of the cell and both halves are
+// ordered recursively below them. On road networks this keeps the fill-in of
+// the elimination, and so the work of a customization, close to minimal.
+std::vector<int> dissection_order(const Graph& graph, const std::vector<std::vector<int>>& neighbours) {
+  int node_count = static_cast<int>(neighbours.size());
+  std::vector<int> rank(node_count, -1);
+  std::vector<int> side(node_count, 0);
+  int stamp = 0;
+
+  // Cells to split, with the first rank of each
+  std::vector<std::pair<std::vector<int>, int>> cells;
+  std::vector<int> all(node_count);
+  for (int v = 0; v < node_count; ++v) {
+    all[v] = v;
+  }
+  cells.push_back({std::move(all), 0});
+
+  while (!cells.empty()) {
+    std::vector<int> cell = std::move(cells.back().first);
+    int first = cells.back().second;
+    cells.pop_back();
+
+    if (cell.size() <= DISSECTION_LEAF_SIZE) {
+      for (int v : cell) {
+        rank[v] = first++;
+      }
+      continue;
+    }
+
+    // Smallest boundary over both axes and both halves
+    std::vector<int> best_separator;
+    std::vector<int> best_cell;
+    size_t half = cell.size() / 2;
+    for (int axis = 0; axis < 2; ++axis) {
+      std::nth_element(cell.begin(), cell.begin() + half, cell.end(), [&](int a, int b) {
+        double ka = axis == 0 ? graph.node_x(a) : graph.node_y(a);
+        double kb = axis == 0 ? graph.node_x(b) : graph.node_y(b);
+        return ka < kb || (ka == kb && a < b);
+      });
+      stamp += 2;
+      for (size_t i = 0; i < cell.size(); ++i) {
+        side[cell[i]] = i < half ? stamp : stamp + 1;
+      }
+      std::vector<int> boundary[2];
+      for (int v : cell) {
+        for (int w : neighbours[v]) {
+          if ((side[w] == stamp || side[w] == stamp + 1) && side[w] != side[v]) {
+            boundary[side[v] - stamp].push_back(v);
+            break;
+          }
+        }
+      }
+      int smaller = boundary[0].size() <= boundary[1].size() ? 0 : 1;
+      if (best_cell.empty() || boundary[smaller].size() < best_separator.size()) {
+        best_separator = boundary[smaller];
+        best_cell = cell;
+      }
+    }
+
+    // The separator goes on top, the halves without it below
+    stamp += 2;
+    for (size_t i = 0; i < best_cell.size(); ++i) {
+      side[best_cell[i]] = i < half ? stamp : stamp + 1;
+    }
+    int last = first + static_cast<int>(best_cell.size());
+    for (int v : best_separator) {
+      side[v] = 0;
+      rank[v] = --last;
+    }
+    std::vector<int> halves[2];
+    for (int v : best_cell) {
+      if (side[v] != 0) {
+        halves[side[v] - stamp].push_back(v);
+      }
+    }
+    int second = first + static_cast<int>(halves[0].size());
+    cells.push_back({std::move(halves[0]), first});
+    cells.push_back({std::move(halves[1]), second});
+  }
+
+  return rank;
+}
+
+}
+
+
+// Parallel worker customizing the nodes of one level of a customizable hierarchy
+class CustomizeWorker : public parallel::Worker {
+public:
+  CustomizeWorker(ContractionHierarchy& ch, int level) : ch_(ch), level_(level) {}
+
+  void operator()(std::size_t begin, std::size_t end) {
+    for (std::size_t i = begin; i < end; ++i) {
+      ch_.customize_node(ch_.cch_.level_nodes[ch_.cch_.level_offsets[level_] + i]);
+    }
+  }
+
+private:
+  ContractionHierarchy& ch_;
+  int level_;
+};
+
+
+// Constructor
+ContractionHierarchy::ContractionHierarchy(const Graph& graph, int profile, const std::string& mode, bool customizable)
+  : customizable_(customizable) {
+  const Graph::Adjacency& adjacency = graph.forward_adjacency(profile);
+  const Buffer<Graph::Weight>& weights = mode == "time" ? adjacency.cost : adjacency.length;
+  node_count_ = graph.node_count();
+  rank_.assign(node_count_, -1);
+
+  if (customizable_) {
+    cch_.mode = mode;
+    build_customizable(graph, profile);
+    customize(graph, profile);
+    return;
+  }
+
+  Contractor contractor(node_count_, arcs_);
+
+  // Insert the edges of the active profile, dropping self loops
+  for (int u = 0; u < node_count_; ++u) {
+    for (int e = adjacency.offsets[u]; e < adjacency.offsets[u + 1]; ++e) {
+      int v = adjacency.targets[e];
+      if (u == v) {
+        continue;
+      }
+      int arc_id = static_cast<int>(arcs_.size());
+      arcs_.push_back({u, v, weights[e], adjacency.edge_ids[e], -1, -1});
+      contractor.add_arc(u, v, weights[e], arc_id);
+    }
+  }
+
+  // Contract nodes in order of their edge difference
+  using PriorityNodePair = std::pair<int, int>;
+  std::priority_queue<PriorityNodePair, std::vector<PriorityNodePair>, std::greater<PriorityNodePair>> queue;
+  for (int v = 0; v < node_count_; ++v) {
+    queue.push({contractor.priority(v), v});
+  }
+
+  std::vector<std::vector<DynamicArc>> upward_out(node_count_);
+  std::vector<std::vector<DynamicArc>> upward_in(node_count_);
+  int next_rank = 0;
+  while (!queue.empty()) {
+    int v = queue.top().second;
+    queue.pop();
+
+    // Lazy update: re-insert v if its priority got worse
+    int priority = contractor.priority(v);
+    if (!queue.empty() && priority > queue.top().first) {
+      queue.push({priority, v});
+      continue;
+    }
+
+    contractor.contract(v, upward_out[v], upward_in[v]);
+    rank_[v] = next_rank++;
+  }
+
+  forward_ = make_upward_graph(upward_out);
+  backward_ = make_upward_graph(upward_in);
+  build_sweep_graph();
+}
+
+
+// Getters
+int ContractionHierarchy::node_count() const {
+  return node_count_;
+}
+
+const std::vector<int>& ContractionHierarchy::rank() const {
+  return rank_;
+}
+
+const std::vector<ContractionHierarchy::Arc>& ContractionHierarchy::arcs() const {
+  return arcs_;
+}
+
+const ContractionHierarchy::UpwardGraph& ContractionHierarchy::forward_graph() const {
+  return forward_;
+}
+
+const ContractionHierarchy::UpwardGraph& ContractionHierarchy::backward_graph() const {
+  return backward_;
+}
+
+const ContractionHierarchy::SweepGraph& ContractionHierarchy::sweep_graph() const {
+  return sweep_;
+}
+
+bool ContractionHierarchy::customizable() const {
+  return customizable_;
+}
+
+
+// Customization: the weight of every arc starts at the cheapest edge between
+// its nodes and is lowered through the lower triangles of the arc, level by
+// level from the bottom of the hierarchy. The upward graphs are then rebuilt
+// without the arcs that no path uses.
+void ContractionHierarchy::customize(const Graph& graph, int profile) {
+  if (!customizable_) {
+    throw std::runtime_error("The contraction hierarchy is not customizable.");
+  }
+  const Graph::Adjacency& adjacency = graph.forward_adjacency(profile);
+  const Buffer<Graph::Weight>& weights = cch_.mode == "time" ? adjacency.cost : adjacency.length;
+
+  std::fill(cch_.up_weight.begin(), cch_.up_weight.end(), std::numeric_limits<double>::infinity());
+  std::fill(cch_.down_weight.begin(), cch_.down_weight.end(), std::numeric_limits<double>::infinity());
+  for (int u = 0; u < node_count_; ++u) {
+    for (int e = adjacency.offsets[u]; e < adjacency.offsets[u + 1]; ++e) {
+      int v = adjacency.targets[e];
+      if (u == v) {
+        continue;
+      }
+      if (rank_[u] < rank_[v]) {
+        double& weight = cch_.up_weight[find_up_arc(u, v)];
+        weight = std::min(weight, static_cast<double>(weights[e]));
+      } else {
+        double& weight = cch_.down_weight[find_up_arc(v, u)];
+        weight = std::min(weight, static_cast<double>(weights[e]));
+      }
+    }
+  }
+
+  // Small levels near the top are not worth a parallel dispatch
+  for (size_t level = 0; level + 1 < cch_.level_offsets.size(); ++level) {
+    int size = cch_.level_offsets[level + 1] - cch_.level_offsets[level];
+    CustomizeWorker worker(*this, static_cast<int>(level));
+    if (size >= 256) {
+      parallel::parallelFor(0, size, worker, 64);
+    } else {
+      worker(0, size);
+    }
+  }
+
+  std::vector<std::vector<DynamicArc>> upward_out(node_count_);
+  std::vector<std::vector<DynamicArc>> upward_in(node_count_);
+  for (int u = 0; u < node_count_; ++u) {
+    for (int a = cch_.up_offsets[u]; a < cch_.up_offsets[u + 1]; ++a) {
+      int w = cch_.up_targets[a];
+      if (cch_.up_weight[a] < std::numeric_limits<double>::infinity()) {
+        upward_out[u].push_back({w, cch_.up_weight[a], a});
+      }
+      if (cch_.down_weight[a] < std::numeric_limits<double>::infinity()) {
+        upward_in[u].push_back({w, cch_.down_weight[a], a});
+      }
+    }
+  }
+  forward_ = make_upward_graph(upward_out);
+  backward_ = make_upward_graph(upward_in);
+  build_sweep_graph();
+}
+
+
+// Queries
+
+// Point-to-point query: bidirectional Dijkstra on the upward graphs. The
+// workspaces must be sized for the graph of the hierarchy.
+double ContractionHierarchy::distance(int source, int target, SearchWorkspace& forward, SearchWorkspace& backward) const {
+  if (source == target) {
+    return 0.0;
+  }
+
+  const UpwardGraph* graphs[2] = {&forward_, &backward_};
+  SearchWorkspace* search[2] = {&forward, &backward};
+  forward.reset();
+  backward.reset();
+  forward.update(source, 0.0);
+  backward.update(target, 0.0);
+  forward.push(0.0, source);
+  backward.push(0.0, target);
+
+  double best = std::numeric_limits<double>::max();
+  bool done[2] = {false, false};
+  int side = 0;
+  while (true) {
+    // Alternate between both directions, skipping finished ones
+    bool open[2] = {!done[0] && !forward.empty(), !done[1] && !backward.empty()};
+    if (!open[0] && !open[1]) {
+      break;
+    }
+    if (!open[side]) {
+      side = 1 - side;
+    }
+    SearchWorkspace& current = *search[side];
+    const SearchWorkspace& other = *search[1 - side];
+    double current_cost = current.top().first;
+    int current_node = current.top().second;
+    current.pop();
+
+    // A direction is done once its smallest key cannot improve the best path
+    if (current_cost >= best) {
+      done[side] = true;
+      side = 1 - side;
+      continue;
+    }
+
+    double other_cost = other.cost(current_node);
+    if (other_cost < std::numeric_limits<double>::max()) {
+      best = std::min(best, current_cost + other_cost);
+    }
+
+    const UpwardGraph& upward = *graphs[side];
+    for (int e = upward.offsets[current_node]; e < upward.offsets[current_node + 1]; ++e) {
+      int to = upward.targets[e];
+      double new_cost = current_cost + upward.weights[e];
+      if (new_cost < current.cost(to)) {
+        current.update(to, new_cost);
+        current.push(new_cost, to);
+      }
+    }
+
+    side = 1 - side;
+  }
+
+  return best;
+}
+
+// Upward search space of a node with its distances, pruned at max_cost
+std::vector<std::pair<int, double>> ContractionHierarchy::upward_search(int node, bool forward, SearchWorkspace& workspace,
+                                                                        double max_cost) const {
+  const UpwardGraph& upward = forward ? forward_ : backward_;
+  std::vector<std::pair<int, double>> space;
+
+  workspace.reset();
+  workspace.update(node, 0.0);
+  workspace.push(0.0, node);
+
+  while (!workspace.empty()) {
+    double current_cost = workspace.top().first;
+    int current_node = workspace.top().second;
+    workspace.pop();
+
+    if (current_cost > max_cost) {
+      break;
+    }
+    space.push_back({current_node, current_cost});
+
+    for (int e = upward.offsets[current_node]; e < upward.offsets[current_node + 1]; ++e) {
+      int to = upward.targets[e];
+      double new_cost = current_cost + upward.weights[e];
+      if (new_cost < workspace.cost(to)) {
+        workspace.update(to, new_cost);
+        workspace.push(new_cost, to);
+      }
+    }
+  }
+
+  return space;
+}
+
+// Store the backward search spaces of all targets in per-node buckets
+ContractionHierarchy::Buckets ContractionHierarchy::build_buckets(
+    const std::vector<std::vector<std::pair<int, double>>>& backward_spaces) const {
+  Buckets buckets;
+  buckets.offsets.assign(node_count_ + 1, 0);
+  for (const auto& space : backward_spaces) {
+    for (const auto& entry : space) {
+      buckets.offsets[entry.first + 1]++;
+    }
+  }
+  for (int u = 0; u < node_count_; ++u) {
+    buckets.offsets[u + 1] += buckets.offsets[u];
+  }
+
+  std::vector<int> position(buckets.offsets.begin(), buckets.offsets.end() - 1);
+  buckets.target_index.resize(buckets.offsets[node_count_]);
+  buckets.distance.resize(buckets.offsets[node_count_]);
+  for (size_t j = 0; j < backward_spaces.size(); ++j) {
+    for (const auto& entry : backward_spaces[j]) {
+      int pos = position[entry.first]++;
+      buckets.target_index[pos] = static_cast<int>(j);
+      buckets.distance[pos] = entry.second;
+    }
+  }
+
+  return buckets;
+}
+
+// Many-to-many query: scan the buckets of the forward search space of source.
+// row must hold one entry per target and is overwritten with the distances.
+void ContractionHierarchy::query_buckets(int source, const Buckets& buckets, SearchWorkspace& workspace,
+                                         std::vector<double>& row) const {
+  std::fill(row.begin(), row.end(), std::numeric_limits<double>::max());
+
+  for (const auto& entry : upward_search(source, true, workspace)) {
+    for (int b = buckets.offsets[entry.first]; b < buckets.offsets[entry.first + 1]; ++b) {
+      double cost = entry.second + buckets.distance[b];
+      int j = buckets.target_index[b];
+      if (cost < row[j]) {
+        row[j] = cost;
+      }
+    }
+  }
+}
+
+
+// Helper methods
+
+// The incoming downward arcs of a node are exactly its backward upward arcs
+void ContractionHierarchy::build_sweep_graph() {
+  sweep_.order.assign(node_count_, 0);
+  sweep_.position.assign(node_count_, 0);
+  for (int v = 0; v < node_count_; ++v) {
+    int pos = node_count_ - 1 - rank_[v];
+    sweep_.order[pos] = v;
+    sweep_.position[v] = pos;
+  }
+
+  sweep_.offsets.assign(node_count_ + 1, 0);
+  sweep_.sources.clear();
+  sweep_.weights.clear();
+  sweep_.sources.reserve(backward_.targets.size());
+  sweep_.weights.reserve(backward_.targets.size());
+  for (int pos = 0; pos < node_count_; ++pos) {
+    int v = sweep_.order[pos];
+    for (int e = backward_.offsets[v]; e < backward_.offsets[v + 1]; ++e) {
+      sweep_.sources.push_back(sweep_.position[backward_.targets[e]]);
+      sweep_.weights.push_back(backward_.weights[e]);
+    }
+    sweep_.offsets[pos + 1] = static_cast<int>(sweep_.sources.size());
+  }
+
+  // Outgoing arcs by source position (counting sort of the incoming arcs)
+  sweep_.down_offsets.assign(node_count_ + 1, 0);
+  for (int source : sweep_.sources) {
+    sweep_.down_offsets[source + 1]++;
+  }
+  for (int pos = 0; pos < node_count_; ++pos) {
+    sweep_.down_offsets[pos + 1] += sweep_.down_offsets[pos];
+  }
+  std::vector<int> next(sweep_.down_offsets.begin(), sweep_.down_offsets.end() - 1);
+  sweep_.down_targets.assign(sweep_.sources.size(), 0);
+  sweep_.down_arcs.assign(sweep_.sources.size(), 0);
+  for (int pos = 0; pos < node_count_; ++pos) {
+    for (int a = sweep_.offsets[pos]; a < sweep_.offsets[pos + 1]; ++a) {
+      int slot = next[sweep_.sources[a]]++;
+      sweep_.down_targets[slot] = pos;
+      sweep_.down_arcs[slot] = a;
+    }
+  }
+}
+
+// Metric-independent contraction: nodes are eliminated in nested dissection
+// order of their coordinates (separators last) on the undirected graph, and
+// the remaining neighbours of every eliminated node are joined pairwise,
+// which yields a chordal supergraph
+void ContractionHierarchy::build_customizable(const Graph& graph, int profile) {
+  // Every edge the profile routes at some speed, so that speed updates that
+  // open or close edges only change weights
+  std::vector<std::vector<int>> neighbours(node_count_);
+  for (const std::pair<int, int>& edge : graph.routable_edges(profile)) {
+    if (edge.first != edge.second) {
+      neighbours[edge.first].push_back(edge.second);
+      neighbours[edge.second].push_back(edge.first);
+    }
+  }
+  for (std::vector<int>& list : neighbours) {
+    std::sort(list.begin(), list.end());
+    list.erase(std::unique(list.begin(), list.end()), list.end());
+  }
+
+  // Eliminate the nodes in rank order, connecting the higher neighbours of
+  // every eliminated node (fill-in)
+  rank_ = dissection_order(graph, neighbours);
+  std::vector<int> order(node_count_);
+  for (int v = 0; v < node_count_; ++v) {
+    order[rank_[v]] = v;
+  }
+  std::vector<std::vector<int>> upward(node_count_);
+  std::vector<int> stamp(node_count_, -1);
+  for (int v : order) {
+    upward[v] = neighbours[v];
+    for (int a : upward[v]) {
+      std::vector<int>& list = neighbours[a];
+      list.erase(std::find(list.begin(), list.end(), v));
+      for (int b : list) {
+        stamp[b] = a;
+      }
+      for (int b : upward[v]) {
+        if (b != a && stamp[b] != a) {
+          list.push_back(b);
+        }
+      }
+    }
+    neighbours[v].clear();
+  }
+
+  // Upward arcs in CSR layout, sorted by the rank of their target
+  cch_.up_offsets.assign(node_count_ + 1, 0);
+  for (int u = 0; u < node_count_; ++u) {
+    std::sort(upward[u].begin(), upward[u].end(), [this](int a, int b) { return rank_[a] < rank_[b]; });
+    cch_.up_offsets[u + 1] = cch_.up_offsets[u] + static_cast<int>(upward[u].size());
+  }
+  cch_.up_targets.clear();
+  cch_.up_targets.reserve(cch_.up_offsets[node_count_]);
+  for (int u = 0; u < node_count_; ++u) {
+    cch_.up_targets.insert(cch_.up_targets.end(), upward[u].begin(), upward[u].end());
+  }
+  cch_.up_weight.assign(cch_.up_targets.size(), std::numeric_limits<double>::infinity());
+  cch_.down_weight.assign(cch_.up_targets.size(), std::numeric_limits<double>::infinity());
+
+  // Arcs from the lower neighbours of every node
+  cch_.down_offsets.assign(node_count_ + 1, 0);
+  for (int w : cch_.up_targets) {
+    cch_.down_offsets[w + 1]++;
+  }
+  for (int u = 0; u < node_count_; ++u) {
+    cch_.down_offsets[u + 1] += cch_.down_offsets[u];
+  }
+  std::vector<int> position(cch_.down_offsets.begin(), cch_.down_offsets.end() - 1);
+  cch_.down_arcs.resize(cch_.up_targets.size());
+  cch_.down_sources.resize(cch_.up_targets.size());
+  for (int u = 0; u < node_count_; ++u) {
+    for (int a = cch_.up_offsets[u]; a < cch_.up_offsets[u + 1]; ++a) {
+      int pos = position[cch_.up_targets[a]]++;
+      cch_.down_arcs[pos] = a;
+      cch_.down_sources[pos] = u;
+    }
+  }
+
+  // Level of a node: one above its highest lower neighbour
+  std::vector<int> level(node_count_, 0);
+  int level_count = 0;
+  for (int v : order) {
+    for (int d = cch_.down_offsets[v]; d < cch_.down_offsets[v + 1]; ++d) {
+      level[v] = std::max(level[v], level[cch_.down_sources[d]] + 1);
+    }
+    level_count = std::max(level_count, level[v] + 1);
+  }
+  cch_.level_offsets.assign(level_count + 1, 0);
+  for (int v = 0; v < node_count_; ++v) {
+    cch_.level_offsets[level[v] + 1]++;
+  }
+  for (int l = 0; l < level_count; ++l) {
+    cch_.level_offsets[l + 1] += cch_.level_offsets[l];
+  }
+  std::vector<int> level_position(cch_.level_offsets.begin(), cch_.level_offsets.end() - 1);
+  cch_.level_nodes.resize(node_count_);
+  for (int v : order) {
+    cch_.level_nodes[level_position[level[v]]++] = v;
+  }
+}
+
+// Index of the upward arc (u, w), or -1 if there is none
+int ContractionHierarchy::find_up_arc(int u, int w) const {
+  std::vector<int>::const_iterator first = cch_.up_targets.begin() + cch_.up_offsets[u];
+  std::vector<int>::const_iterator last = cch_.up_targets.begin() + cch_.up_offsets[u + 1];
+  std::vector<int>::const_iterator it = std::lower_bound(first, last, w, [this](int a, int b) {
+    return rank_[a] < rank_[b];
+  });
+  return it != last && *it == w ? static_cast<int>(it - cch_.up_targets.begin()) : -1;
+}
+
+// Lowers the weights of the upward arcs (u, w) of u through the lower
+// triangles (z, u, w); the arcs of z are final as z is on a lower level. The
+// arcs of z above u follow its arc to u, and each of their targets is also a
+// higher neighbour of u, so both rank-sorted lists are matched in one merge.
+void ContractionHierarchy::customize_node(int u) {
+  for (int d = cch_.down_offsets[u]; d < cch_.down_offsets[u + 1]; ++d) {
+    int z = cch_.down_sources[d];
+    int zu = cch_.down_arcs[d];
+    int uw = cch_.up_offsets[u];
+    for (int zw = zu + 1; zw < cch_.up_offsets[z + 1]; ++zw) {
+      int w = cch_.up_targets[zw];
+      while (cch_.up_targets[uw] != w) {
+        ++uw;
+      }
+      cch_.up_weight[uw] = std::min(cch_.up_weight[uw], cch_.down_weight[zu] + cch_.up_weight[zw]);
+      cch_.down_weight[uw] = std::min(cch_.down_weight[uw], cch_.down_weight[zw] + cch_.up_weight[zu]);
+    }
+  }
+}
@@ -0,0 +1,123 @@
+#ifndef CONTRACTION_HIERARCHY_H
+#define CONTRACTION_HIERARCHY_H
+
+#include "graph.h"
+#include "search_workspace.h"
+#include <vector>
+#include <string>
+#include <utility>
+#include <limits>
+
+class ContractionHierarchy {
+public:
+  // Constructor: contracts a routing profile of the graph for the given mode ("time" or "distance").
+  // A customizable hierarchy is contracted in a metric-independent order (nested dissection of the
+  // node coordinates) without witness searches, so its topology holds for any arc weights and customize() can replace them.
+  // It spans every edge the profile routes at some speed; edges that are closed at the current speeds get infinite weights.
+  ContractionHierarchy(const Graph& graph, int profile, const std::string& mode, bool customizable = false);
+
+  // Arc of the hierarchy: either an edge of the graph (edge_id >= 0) or a
+  // shortcut that bypasses a contracted node (first and second are the arcs it replaces).
+  // Customizable hierarchies do not record their arcs.
+  struct Arc {
+    int from;
+    int to;
+    double weight;
+    int edge_id;
+    int first;
+    int second;
+  };
+
+  // Upward graph in CSR layout: the arcs of node u lead to nodes of higher rank
+  struct UpwardGraph {
+    std::vector<int> offsets;
+    std::vector<int> targets;
+    std::vector<double> weights;
+    std::vector<int> arc_ids;
+  };
+
+  // Downward sweep for PHAST, laid out by descending rank: the node at
+  // position p is order[p], and its incoming arcs from higher ranked nodes
+  // are stored at offsets[p] .. offsets[p + 1] - 1 with source positions.
+  // The same arcs by source: the outgoing arcs of position p are stored at
+  // down_offsets[p] .. down_offsets[p + 1] - 1, as target positions and the
+  // indices of the arcs in sources and weights.
+  struct SweepGraph {
+    std::vector<int> order;
+    std::vector<int> position;
+    std::vector<int> offsets;
+    std::vector<int> sources;
+    std::vector<double> weights;
+    std::vector<int> down_offsets;
+    std::vector<int> down_targets;
+    std::vector<int> down_arcs;
+  };
+
+  // Bucket index for many-to-many queries: entries of node u are stored at
+  // positions offsets[u] .. offsets[u + 1] - 1
+  struct Buckets {
+    std::vector<int> offsets;
+    std::vector<int> target_index;
+    std::vector<double> distance;
+  };
+
+  // Getters
+  int node_count() const;
+  const std::vector<int>& rank() const;
+  const std::vector<Arc>& arcs() const;
+  const UpwardGraph& forward_graph() const;
+  const UpwardGraph& backward_graph() const;
+  const SweepGraph& sweep_graph() const;
+  bool customizable() const;
+  
+  // Re-computes the weights of a customizable hierarchy from the current arc
+  // weights of its profile, in parallel over the levels of the hierarchy
+  void customize(const Graph& graph, int profile);
+
+  // Queries; the search workspaces come from the pool of the graph
+  double distance(int source, int target, SearchWorkspace& forward, SearchWorkspace& backward) const;
+  std::vector<std::pair<int, double>> upward_search(int node, bool forward, SearchWorkspace& workspace,
+                                                   double max_cost = std::numeric_limits<double>::max()) const;
+  Buckets build_buckets(const std::vector<std::vector<std::pair<int, double>>>& backward_spaces) const;
+  void query_buckets(int source, const Buckets& buckets, SearchWorkspace& workspace, std::vector<double>& row) const;
+
+private:
+  friend class CustomizeWorker;
+  
+  // Topology of a customizable hierarchy: the undirected arcs of node u to its
+  // higher ranked neighbours are stored at up_offsets[u] .. up_offsets[u + 1] - 1,
+  // in rank order; down_offsets and down_arcs list the arcs from the lower
+  // ranked neighbours of every node. Nodes of the same level have no lower
+  // neighbour in that level or above, so a level is customized in parallel.
+  struct Customizable {
+    std::string mode;
+    std::vector<int> up_offsets;
+    std::vector<int> up_targets;
+    std::vector<int> down_offsets;
+    std::vector<int> down_arcs;
+    std::vector<int> down_sources;
+    std::vector<int> level_offsets;
+    std::vector<int> level_nodes;
+    // Weights of arc (u, w): upward u -> w and downward w -> u
+    std::vector<double> up_weight;
+    std::vector<double> down_weight;
+  };
+  
+  // Member variables
+  int node_count_;
+  std::vector<int> rank_;
+  std::vector<Arc> arcs_;
+  UpwardGraph forward_;
+  UpwardGraph backward_;
+  SweepGraph sweep_;
+  bool customizable_;
+  Customizable cch_;
+  
+  // Helper methods
+  void build_sweep_graph();
+  void build_customizable(const Graph& graph, int profile);
+  int find_up_arc(int u, int w) const;
+  void customize_node(int u);
+};
+
+#endif // CONTRACTION_HIERARCHY_H
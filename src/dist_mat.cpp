@@ -1,137 +1,688 @@
 #include "dist_mat.h"
-#include <queue>
+#include "contraction_hierarchy.h"
+#include "landmarks.h"
+#include "tree_cache.h"
+#include "parallel.h"
 #include <cmath>
+#include <chrono>
 #include <limits>
 #include <algorithm>
 #include <set>
-#include <Rcpp.h>
+#include <stdexcept>
 
-// [[Rcpp::depends(RcppParallel)]]
-#include <RcppParallel.h>
+// Internal dist_mat methods, compiled per cost, heuristic and counter policy
+template <typename Cost, typename Heuristic, typename Counters>
+void _dist_mat(const Graph::Adjacency& adjacency, const Cost& cost, Heuristic& heuristic, int start_node, const std::vector<int>& end_nodes,
+               SearchWorkspace& workspace, const DistMatOutput& out, DistMatPaths* paths, std::size_t start_index, Counters& counters);
+template <typename Cost, typename Counters>
+void _dist_mat_one_to_many(const Graph::Adjacency& adjacency, const Cost& cost, int start_node, const std::vector<int>& end_nodes,
+                           SearchWorkspace& workspace, const DistMatOutput& out, DistMatPaths* paths, std::size_t start_index,
+                           Counters& counters);
+template <typename Cost, typename Counters>
+void _dist_mat_cached(TreeCache& cache, const TreeCache::Key& key, const Graph::Adjacency& adjacency, const Cost& cost,
+                      const std::vector<int>& end_nodes, SearchWorkspace& workspace, const DistMatOutput& out, Counters& counters);
+template <typename Cost>
+void _append_path(const Graph::Adjacency& adjacency, const Cost& cost, const SearchWorkspace& workspace, int end_node, bool reached,
+                  DistMatPaths& paths, std::size_t start_index, std::size_t row);
+template <typename Cost>
+std::tuple<int, int, double> _bidirectional_dijkstra(const Graph::Adjacency& forward_adjacency, const Graph::Adjacency& reverse_adjacency,
+                                                     const Cost& forward_cost, const Cost& reverse_cost, int start_node, int end_node,
+                                                     SearchWorkspace& forward, SearchWorkspace& backward);
 
-// RcppParallel worker
-class DistMatWorker : public RcppParallel::Worker {
+// Parallel worker: one-to-many Dijkstra per start node, through the tree
+// cache if one is given, or an A* search per pair of nodes
+template <typename Cost, typename Heuristic>
+class DistMatWorker : public parallel::Worker {
 public:
   DistMatWorker(const Graph& graph,
+                TreeCache* cache,
+                int profile,
+                const Metric& metric,
+                const Graph::Adjacency& adjacency,
+                const Cost& cost,
+                const Heuristic& heuristic,
+                bool astar,
                 const std::vector<int>& start_nodes,
                 const std::vector<int>& end_nodes,
-                const std::string& mode,
-                std::vector<std::vector<std::tuple<int, int, double>>>& results)
-    : graph_(graph), start_nodes_(start_nodes), end_nodes_(end_nodes), mode_(mode), results_(results) {}
+                const DistMatOutput& out,
+                DistMatPaths* paths,
+                std::vector<QueryStats>* stats)
+    : graph_(graph), cache_(cache), profile_(profile), metric_(metric), adjacency_(adjacency), cost_(cost), heuristic_(heuristic), astar_(astar),
+      start_nodes_(start_nodes), end_nodes_(end_nodes), out_(out), paths_(paths), stats_(stats) {}
   
-  // Process start nodes in parallel
+  // Process start nodes in parallel, reusing one workspace and heuristic per chunk
   void operator()(std::size_t begin, std::size_t end) {
+    WorkspacePool::Lease workspace(graph_.workspaces());
+    parallel::SlotPool::Lease slot(slots_);
+    Heuristic heuristic(heuristic_);
+    NoCounters no_counters;
     for (std::size_t i = begin; i < end; ++i) {
-      std::vector<std::tuple<int, int, double>> path = _dist_mat(graph_, {start_nodes_[i]}, end_nodes_, mode_)[0];
-      results_[i] = path;
+      if (!stats_) {
+        search(heuristic, i, *workspace, no_counters);
+        continue;
+      }
+      
+      // Count into a local copy, so that threads never write next to each other
+      QueryStats stats;
+      QueryCounters counters(stats);
+      std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+      search(heuristic, i, *workspace, counters);
+      stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+      stats.start = start_nodes_[i];
+      stats.thread = *slot;
+      (*stats_)[i] = stats;
     }
   }
   
 private:
+  template <typename Counters>
+  void search(Heuristic& heuristic, std::size_t i, SearchWorkspace& workspace, Counters& counters) {
+    DistMatOutput row = out_.row(i);
+    if (astar_) {
+      _dist_mat(adjacency_, cost_, heuristic, start_nodes_[i], end_nodes_, workspace, row, paths_, i, counters);
+    } else if (cache_) {
+      _dist_mat_cached(*cache_, TreeCache::Key(profile_, metric_, start_nodes_[i]), adjacency_, cost_, end_nodes_, workspace, row, counters);
+    } else {
+      _dist_mat_one_to_many(adjacency_, cost_, start_nodes_[i], end_nodes_, workspace, row, paths_, i, counters);
+    }
+  }
+  
   const Graph& graph_;
+  TreeCache* cache_;
+  int profile_;
+  Metric metric_;
+  const Graph::Adjacency& adjacency_;
+  Cost cost_;
+  Heuristic heuristic_;
+  bool astar_;
   const std::vector<int>& start_nodes_;
   const std::vector<int>& end_nodes_;
-  const std::string& mode_;
-  std::vector<std::vector<std::tuple<int, int, double>>>& results_;
+  DistMatOutput out_;
+  DistMatPaths* paths_;
+  std::vector<QueryStats>* stats_;
+  parallel::SlotPool slots_;
 };
 
+// Runs the distance matrix workers with the cost policy chosen by dispatch_cost
+class DistMatRun {
+public:
+  DistMatRun(const Graph& graph,
+             int profile,
+             const std::vector<int>& start_nodes,
+             const std::vector<int>& end_nodes,
+             const Metric& metric,
+             const std::string& engine,
+             const std::string& heuristic,
+             const DistMatOutput& out,
+             DistMatPaths* paths,
+             std::vector<QueryStats>* stats,
+             const parallel::Schedule& schedule)
+    : graph_(graph), adjacency_(graph.forward_adjacency(profile)), profile_(profile), start_nodes_(start_nodes), end_nodes_(end_nodes),
+      metric_(metric), engine_(engine), heuristic_(heuristic), out_(out), paths_(paths), stats_(stats), schedule_(schedule) {}
+  
+  template <typename Cost>
+  void operator()(const Cost& cost) {
+    if (engine_ == "dijkstra") {
+      run(cost, NoHeuristic(), false);
+    } else if (heuristic_ == "alt") {
+      run(cost, LandmarkHeuristic(graph_.landmarks(profile_, metric_.mode())), true);
+    } else if (heuristic_ == "euclidean") {
+      run(cost, EuclideanHeuristic(graph_, adjacency_, cost), true);
+    } else if (heuristic_ == "none") {
+      run(cost, NoHeuristic(), true);
+    } else {
+      throw std::runtime_error("Invalid A* heuristic.");
+    }
+  }
+  
+private:
+  // The tree cache holds costs only, so searches that collect paths bypass it
+  template <typename Cost, typename Heuristic>
+  void run(const Cost& cost, const Heuristic& heuristic, bool astar) {
+    TreeCache* cache = astar || paths_ ? nullptr : graph_.tree_cache();
+    DistMatWorker<Cost, Heuristic> worker(graph_, cache, profile_, metric_, adjacency_, cost, heuristic, astar, start_nodes_, end_nodes_, out_,
+                                          paths_, stats_);
+    parallel::parallelFor(0, start_nodes_.size(), worker, schedule_);
+  }
+  
+  const Graph& graph_;
+  const Graph::Adjacency& adjacency_;
+  int profile_;
+  const std::vector<int>& start_nodes_;
+  const std::vector<int>& end_nodes_;
+  const Metric& metric_;
+  const std::string& engine_;
+  const std::string& heuristic_;
+  DistMatOutput out_;
+  DistMatPaths* paths_;
+  std::vector<QueryStats>* stats_;
+  const parallel::Schedule& schedule_;
+};
+
+
+DistMatOutput DistMatOutput::columns(int* start, int* end, double* cost, std::size_t end_count) {
+  DistMatOutput out = {start, end, cost, nullptr, 1.0, std::numeric_limits<double>::max(), -1, end_count, 1};
+  return out;
+}
+
+DistMatOutput DistMatOutput::matrix(double* cost, std::size_t start_count, double missing) {
+  DistMatOutput out = {nullptr, nullptr, cost, nullptr, 1.0, missing, -1, 1, start_count};
+  return out;
+}
+
+DistMatOutput DistMatOutput::integer_matrix(int* cost, std::size_t start_count, double scale, int missing) {
+  DistMatOutput out = {nullptr, nullptr, nullptr, cost, scale, 0.0, missing, 1, start_count};
+  return out;
+}
+
 
-// RcppParallel method
-std::vector<std::vector<std::tuple<int, int, double>>> parallelCalculateDistMat(
-    const Graph& graph, const std::vector<int>& start_nodes, const std::vector<int>& end_nodes, const std::string& mode) {
+// Parallel worker copying the routes of every start node into the flat layout
+class PathFlattenWorker : public parallel::Worker {
+public:
+  PathFlattenWorker(const DistMatPaths& paths, const int* offsets, int* node, int* edge)
+    : paths_(paths), offsets_(offsets), node_(node), edge_(edge) {}
   
-  std::vector<std::vector<std::tuple<int, int, double>>> results(start_nodes.size(), std::vector<std::tuple<int, int, double>>(end_nodes.size()));
+  void operator()(std::size_t begin, std::size_t end) {
+    std::size_t rows_per_start = paths_.length.size() / paths_.nodes.size();
+    for (std::size_t i = begin; i < end; ++i) {
+      int first = offsets_[i * rows_per_start];
+      std::copy(paths_.nodes[i].begin(), paths_.nodes[i].end(), node_ + first);
+      std::copy(paths_.edges[i].begin(), paths_.edges[i].end(), edge_ + first);
+    }
+  }
   
-  DistMatWorker worker(graph, start_nodes, end_nodes, mode, results);
-  RcppParallel::parallelFor(0, start_nodes.size(), worker);
+private:
+  const DistMatPaths& paths_;
+  const int* offsets_;
+  int* node_;
+  int* edge_;
+};
+
+std::size_t DistMatPaths::size() const {
+  std::size_t total = 0;
+  for (const std::vector<int>& route_nodes : nodes) {
+    total += route_nodes.size();
+  }
+  return total;
+}
+
+void DistMatPaths::flatten(int* offsets, int* node, int* edge) const {
+  offsets[0] = 0;
+  for (std::size_t row = 0; row < length.size(); ++row) {
+    offsets[row + 1] = offsets[row] + length[row];
+  }
+  if (nodes.empty()) {
+    return;
+  }
+  PathFlattenWorker worker(*this, offsets, node, edge);
+  parallel::parallelFor(0, nodes.size(), worker);
+}
+
+
+// Parallel worker for the backward search spaces of the targets
+class CHBucketWorker : public parallel::Worker {
+public:
+  CHBucketWorker(const Graph& graph,
+                 const ContractionHierarchy& ch,
+                 const std::vector<int>& end_nodes,
+                 std::vector<std::vector<std::pair<int, double>>>& spaces)
+    : graph_(graph), ch_(ch), end_nodes_(end_nodes), spaces_(spaces) {}
   
-  return results;
+  void operator()(std::size_t begin, std::size_t end) {
+    WorkspacePool::Lease workspace(graph_.workspaces());
+    for (std::size_t j = begin; j < end; ++j) {
+      spaces_[j] = ch_.upward_search(end_nodes_[j], false, *workspace);
+    }
+  }
+  
+private:
+  const Graph& graph_;
+  const ContractionHierarchy& ch_;
+  const std::vector<int>& end_nodes_;
+  std::vector<std::vector<std::pair<int, double>>>& spaces_;
+};
+
+// Parallel worker for the forward bucket scans of the start nodes
+class CHDistMatWorker : public parallel::Worker {
+public:
+  CHDistMatWorker(const Graph& graph,
+                  const ContractionHierarchy& ch,
+                  const ContractionHierarchy::Buckets& buckets,
+                  const std::vector<int>& start_nodes,
+                  const std::vector<int>& end_nodes,
+                  const DistMatOutput& out)
+    : graph_(graph), ch_(ch), buckets_(buckets), start_nodes_(start_nodes), end_nodes_(end_nodes), out_(out) {}
+  
+  void operator()(std::size_t begin, std::size_t end) {
+    WorkspacePool::Lease workspace(graph_.workspaces());
+    std::vector<double> row(end_nodes_.size());
+    for (std::size_t i = begin; i < end; ++i) {
+      ch_.query_buckets(start_nodes_[i], buckets_, *workspace, row);
+      DistMatOutput out = out_.row(i);
+      for (std::size_t j = 0; j < end_nodes_.size(); ++j) {
+        if (row[j] < std::numeric_limits<double>::max()) {
+          out.set(j, start_nodes_[i], end_nodes_[j], row[j]);
+        } else {
+          out.set_unreachable(j);
+        }
+      }
+    }
+  }
+  
+private:
+  const Graph& graph_;
+  const ContractionHierarchy& ch_;
+  const ContractionHierarchy::Buckets& buckets_;
+  const std::vector<int>& start_nodes_;
+  const std::vector<int>& end_nodes_;
+  DistMatOutput out_;
+};
+
+// Parallel worker for pairwise queries (start_nodes[i], end_nodes[i]) by bidirectional Dijkstra
+template <typename Cost>
+class PairwiseWorker : public parallel::Worker {
+public:
+  PairwiseWorker(const Graph& graph,
+                 int profile,
+                 const Metric& metric,
+                 const std::vector<int>& start_nodes,
+                 const std::vector<int>& end_nodes,
+                 std::vector<std::tuple<int, int, double>>& results)
+    : graph_(graph), forward_adjacency_(graph.forward_adjacency(profile)), reverse_adjacency_(graph.reverse_adjacency(profile)),
+      forward_cost_(forward_adjacency_, metric), reverse_cost_(reverse_adjacency_, metric),
+      start_nodes_(start_nodes), end_nodes_(end_nodes), results_(results) {}
+  
+  void operator()(std::size_t begin, std::size_t end) {
+    WorkspacePool::Lease forward(graph_.workspaces());
+    WorkspacePool::Lease backward(graph_.workspaces());
+    for (std::size_t i = begin; i < end; ++i) {
+      results_[i] = _bidirectional_dijkstra(forward_adjacency_, reverse_adjacency_, forward_cost_, reverse_cost_,
+                                            start_nodes_[i], end_nodes_[i], *forward, *backward);
+    }
+  }
+  
+private:
+  const Graph& graph_;
+  const Graph::Adjacency& forward_adjacency_;
+  const Graph::Adjacency& reverse_adjacency_;
+  Cost forward_cost_;
+  Cost reverse_cost_;
+  const std::vector<int>& start_nodes_;
+  const std::vector<int>& end_nodes_;
+  std::vector<std::tuple<int, int, double>>& results_;
+};
+
+// Parallel worker for pairwise queries on the contraction hierarchy
+class CHPairwiseWorker : public parallel::Worker {
+public:
+  CHPairwiseWorker(const Graph& graph,
+                   const ContractionHierarchy& ch,
+                   const std::vector<int>& start_nodes,
+                   const std::vector<int>& end_nodes,
+                   std::vector<std::tuple<int, int, double>>& results)
+    : graph_(graph), ch_(ch), start_nodes_(start_nodes), end_nodes_(end_nodes), results_(results) {}
+  
+  void operator()(std::size_t begin, std::size_t end) {
+    WorkspacePool::Lease forward(graph_.workspaces());
+    WorkspacePool::Lease backward(graph_.workspaces());
+    for (std::size_t i = begin; i < end; ++i) {
+      double cost = ch_.distance(start_nodes_[i], end_nodes_[i], *forward, *backward);
+      if (cost < std::numeric_limits<double>::max()) {
+        results_[i] = std::make_tuple(start_nodes_[i], end_nodes_[i], cost);
+      } else {
+        results_[i] = std::make_tuple(-1, -1, std::numeric_limits<double>::max());
+      }
+    }
+  }
+  
+private:
+  const Graph& graph_;
+  const ContractionHierarchy& ch_;
+  const std::vector<int>& start_nodes_;
+  const std::vector<int>& end_nodes_;
+  std::vector<std::tuple<int, int, double>>& results_;
+};
+
+// Runs the pairwise workers with the cost policy chosen by dispatch_cost
+class PairwiseRun {
+public:
+  PairwiseRun(const Graph& graph,
+              int profile,
+              const std::vector<int>& start_nodes,
+              const std::vector<int>& end_nodes,
+              const Metric& metric,
+              std::vector<std::tuple<int, int, double>>& results)
+    : graph_(graph), profile_(profile), start_nodes_(start_nodes), end_nodes_(end_nodes), metric_(metric), results_(results) {}
+  
+  template <typename Cost>
+  void operator()(const Cost&) {
+    PairwiseWorker<Cost> worker(graph_, profile_, metric_, start_nodes_, end_nodes_, results_);
+    parallel::parallelFor(0, start_nodes_.size(), worker);
+  }
+  
+private:
+  const Graph& graph_;
+  int profile_;
+  const std::vector<int>& start_nodes_;
+  const std::vector<int>& end_nodes_;
+  const Metric& metric_;
+  std::vector<std::tuple<int, int, double>>& results_;
+};
+
+
+// Parallel method
+void parallelCalculateDistMat(
+    const Graph& graph, int profile, const std::vector<int>& start_nodes, const std::vector<int>& end_nodes, const Metric& metric,
+    const std::string& engine, const std::string& heuristic, const DistMatOutput& out, DistMatPaths* paths,
+    std::vector<QueryStats>* stats, const parallel::Schedule& schedule) {
+  
+  if (engine != "dijkstra" && engine != "astar" && engine != "ch") {
+    throw std::runtime_error("Invalid distance matrix engine.");
+  }
+  if (paths) {
+    if (engine == "ch") {
+      throw std::runtime_error("Paths are only available for the \"dijkstra\" and \"astar\" engines.");
+    }
+    paths->length.assign(start_nodes.size() * end_nodes.size(), 0);
+    paths->nodes.assign(start_nodes.size(), std::vector<int>());
+    paths->edges.assign(start_nodes.size(), std::vector<int>());
+  }
+  if (stats) {
+    if (engine == "ch") {
+      throw std::runtime_error("Search statistics are only available for the \"dijkstra\" and \"astar\" engines.");
+    }
+    stats->assign(start_nodes.size(), QueryStats());
+  }
+  
+  // Bucket-based many-to-many query on the contraction hierarchy
+  if (engine == "ch") {
+    const ContractionHierarchy& ch = graph.contraction_hierarchy(profile, metric.mode());
+    
+    std::vector<std::vector<std::pair<int, double>>> spaces(end_nodes.size());
+    CHBucketWorker bucket_worker(graph, ch, end_nodes, spaces);
+    parallel::parallelFor(0, end_nodes.size(), bucket_worker);
+    ContractionHierarchy::Buckets buckets = ch.build_buckets(spaces);
+    
+    CHDistMatWorker ch_worker(graph, ch, buckets, start_nodes, end_nodes, out);
+    parallel::parallelFor(0, start_nodes.size(), ch_worker, schedule);
+    return;
+  }
+  
+  DistMatRun run(graph, profile, start_nodes, end_nodes, metric, engine, heuristic, out, paths, stats, schedule);
+  dispatch_cost(graph.forward_adjacency(profile), metric, run);
 }
 
 
+std::vector<std::tuple<int, int, double>> parallelCalculatePairwise(
+    const Graph& graph, int profile, const std::vector<int>& start_nodes, const std::vector<int>& end_nodes, const Metric& metric,
+    const std::string& engine) {
+  
+  if (engine != "bidirectional" && engine != "ch") {
+    throw std::runtime_error("Invalid pairwise engine.");
+  }
+  if (start_nodes.size() != end_nodes.size()) {
+    throw std::runtime_error("Start and end nodes must have the same length.");
+  }
+  
+  std::vector<std::tuple<int, int, double>> results(start_nodes.size());
+  
+  if (engine == "ch") {
+    CHPairwiseWorker worker(graph, graph.contraction_hierarchy(profile, metric.mode()), start_nodes, end_nodes, results);
+    parallel::parallelFor(0, start_nodes.size(), worker);
+  } else {
+    PairwiseRun run(graph, profile, start_nodes, end_nodes, metric, results);
+    dispatch_cost(graph.forward_adjacency(profile), metric, run);
+  }
+  
+  return results;
+}
+
 
 // Internal dist_mat methods
-std::vector<std::vector<std::tuple<int, int, double>>> _dist_mat(const Graph& graph, const std::vector<int>& start_nodes, const std::vector<int>& end_nodes, const std::string& mode) {
-  std::vector<std::vector<std::tuple<int, int, double>>> result(start_nodes.size(), std::vector<std::tuple<int, int, double>>(end_nodes.size()));
-  
-  for (size_t i = 0; i < start_nodes.size(); ++i) {
-    for (size_t j = 0; j < end_nodes.size(); ++j) {
-      int start_node = start_nodes[i];
-      int end_node = end_nodes[j];
+
+// A* search per pair of nodes, guided by the heuristic's lower bounds
+template <typename Cost, typename Heuristic, typename Counters>
+void _dist_mat(const Graph::Adjacency& adjacency, const Cost& cost, Heuristic& heuristic, int start_node, const std::vector<int>& end_nodes,
+               SearchWorkspace& workspace, const DistMatOutput& out, DistMatPaths* paths, std::size_t start_index, Counters& counters) {
+  for (size_t j = 0; j < end_nodes.size(); ++j) {
+    int end_node = end_nodes[j];
+    
+    // Check if from and to are not equal
+    if (start_node == end_node) {
+      out.set(j, start_node, end_node, 0.0);
+      if (paths) {
+        workspace.reset();
+        workspace.update(start_node, 0.0);
+        _append_path(adjacency, cost, workspace, end_node, true, *paths, start_index, start_index * end_nodes.size() + j);
+      }
+      continue;
+    }
+    
+    heuristic.set_target(end_node);
+    workspace.reset();
+    workspace.update(start_node, 0.0);
+    workspace.push(heuristic(start_node), start_node);
+    counters.push();
+    
+    while (!workspace.empty()) {
+      int current_node = workspace.top().second;
+      workspace.pop();
       
-      // Check if from and to are not equal
-      if (start_node == end_node) {
-        result[i][j] = std::make_tuple(start_node, end_node, 0.0);
+      // The heuristics are consistent, so every node is settled once
+      if (workspace.settled(current_node)) {
+        counters.stale();
         continue;
       }
+      workspace.settle(current_node);
+      counters.settle();
       
-      const std::vector<Graph::Edge>& edges = graph.edges();
-      const std::vector<Graph::Node>& nodes = graph.nodes();
-      int node_count = static_cast<int>(nodes.size());
-      
-      // Create an adjacency list from the edges
-      std::vector<std::vector<Graph::Edge>> adjacencyList(node_count);
-      for (const Graph::Edge& edge : edges) {
-        adjacencyList[edge.from].push_back(edge);
+      if (current_node == end_node) {
+        break;
       }
       
-      // Initialize costs and heuristic values
-      std::vector<double> costs(node_count, std::numeric_limits<double>::max());
-      std::vector<double> heuristic_values(node_count, 0.0);
-      
-      // Calculate heuristic values
-      for (int k = 0; k < node_count; ++k) {
-        double dx = nodes[k].x - nodes[end_node].x;
-        double dy = nodes[k].y - nodes[end_node].y;
-        heuristic_values[k] = std::sqrt(dx * dx + dy * dy);
-      }
-      
-      costs[start_node] = 0.0;
-      
-      using NodeCostPair = std::pair<double, int>;
-      std::priority_queue<NodeCostPair, std::vector<NodeCostPair>, std::greater<NodeCostPair>> pq;
-      pq.push({heuristic_values[start_node], start_node});
-      
-      std::vector<int> prev(node_count, -1);
-      
-      while (!pq.empty()) {
-        int current_node = pq.top().second;
-        pq.pop();
-        
-        if (current_node == end_node) {
-          break;
+      double current_cost = workspace.cost(current_node);
+      for (int e = adjacency.offsets[current_node]; e < adjacency.offsets[current_node + 1]; ++e) {
+        int to = adjacency.targets[e];
+        double new_cost = current_cost + cost(e);
+        counters.relax();
+        if (new_cost < workspace.cost(to)) {
+          workspace.update(to, new_cost, current_node);
+          
+          double f_cost = new_cost + heuristic(to);
+          workspace.push(f_cost, to);
+          counters.push();
         }
-        
-        for (const Graph::Edge& edge : adjacencyList[current_node]) {
-          double edge_cost = mode == "time" ? edge.cost : edge.length;
-          double new_cost = costs[current_node] + edge_cost;
-          if (new_cost < costs[edge.to]) {
-            costs[edge.to] = new_cost;
-            prev[edge.to] = current_node;
-            
-            double f_cost = new_cost + heuristic_values[edge.to];
-            pq.push({f_cost, edge.to});
-          }
+      }
+    }
+    
+    if (workspace.settled(end_node)) {
+      out.set(j, start_node, end_node, workspace.cost(end_node));
+    } else {
+      out.set_unreachable(j);
+    }
+    if (paths) {
+      _append_path(adjacency, cost, workspace, end_node, workspace.settled(end_node), *paths, start_index, start_index * end_nodes.size() + j);
+    }
+  }
+}
+
+
+// One-to-many Dijkstra: a single search from start_node that stops as soon
+// as every requested end node has been settled
+template <typename Cost, typename Counters>
+void _dist_mat_one_to_many(const Graph::Adjacency& adjacency, const Cost& cost, int start_node, const std::vector<int>& end_nodes,
+                           SearchWorkspace& workspace, const DistMatOutput& out, DistMatPaths* paths, std::size_t start_index,
+                           Counters& counters) {
+  // Ties may settle in another order in the radix heap, which changes the
+  // parents, so routes are always searched with the 4-ary heap
+  workspace.reset(paths ? SearchWorkspace::HEAP_DARY : workspace.dijkstra_heap());
+  
+  // Mark the distinct targets that still have to be settled
+  int targets_left = 0;
+  for (int end_node : end_nodes) {
+    if (!workspace.marked(end_node)) {
+      workspace.mark(end_node);
+      targets_left++;
+    }
+  }
+  
+  workspace.update(start_node, 0.0);
+  workspace.push(0.0, start_node);
+  counters.push();
+  
+  while (!workspace.empty() && targets_left > 0) {
+    double current_cost = workspace.top().first;
+    int current_node = workspace.top().second;
+    workspace.pop();
+    
+    // Skip stale queue entries
+    if (current_cost > workspace.cost(current_node)) {
+      counters.stale();
+      continue;
+    }
+    counters.settle();
+    
+    if (workspace.marked(current_node)) {
+      workspace.unmark(current_node);
+      targets_left--;
+    }
+    
+    for (int e = adjacency.offsets[current_node]; e < adjacency.offsets[current_node + 1]; ++e) {
+      int to = adjacency.targets[e];
+      double new_cost = current_cost + cost(e);
+      counters.relax();
+      if (new_cost < workspace.cost(to)) {
+        workspace.update(to, new_cost, current_node);
+        workspace.push(new_cost, to);
+        counters.push();
+      }
+    }
+  }
+  
+  for (size_t j = 0; j < end_nodes.size(); ++j) {
+    int end_node = end_nodes[j];
+    bool reached = workspace.cost(end_node) < std::numeric_limits<double>::max();
+    if (reached) {
+      out.set(j, start_node, end_node, workspace.cost(end_node));
+    } else {
+      out.set_unreachable(j);
+    }
+    if (paths) {
+      _append_path(adjacency, cost, workspace, end_node, reached, *paths, start_index, start_index * end_nodes.size() + j);
+    }
+  }
+}
+
+// One-to-many Dijkstra through the tree cache: the costs are read from the
+// cached tree of the start node, which is grown first if it misses an end node
+template <typename Cost, typename Counters>
+void _dist_mat_cached(TreeCache& cache, const TreeCache::Key& key, const Graph::Adjacency& adjacency, const Cost& cost,
+                      const std::vector<int>& end_nodes, SearchWorkspace& workspace, const DistMatOutput& out, Counters& counters) {
+  std::shared_ptr<const SearchTree> tree = cached_search_tree(cache, key, adjacency, cost, 0.0, &end_nodes, workspace, counters);
+  
+  for (size_t j = 0; j < end_nodes.size(); ++j) {
+    int end_node = end_nodes[j];
+    double end_cost = tree->cost_of(end_node);
+    if (end_cost < std::numeric_limits<double>::max()) {
+      out.set(j, key.start, end_node, end_cost);
+    } else {
+      out.set_unreachable(j);
+    }
+  }
+}
+
+// Appends the route to end_node in the search tree of workspace to the routes
+// of a start node. The parents hold nodes only; the arc into a node is the
+// cheapest arc from its parent, which is the one the search relaxed last.
+template <typename Cost>
+void _append_path(const Graph::Adjacency& adjacency, const Cost& cost, const SearchWorkspace& workspace, int end_node, bool reached,
+                  DistMatPaths& paths, std::size_t start_index, std::size_t row) {
+  if (!reached) {
+    return;
+  }
+  
+  std::vector<int>& nodes = paths.nodes[start_index];
+  std::vector<int>& edges = paths.edges[start_index];
+  std::size_t first = nodes.size();
+  for (int node = end_node; node >= 0; node = workspace.parent(node)) {
+    int parent = workspace.parent(node);
+    int edge = -1;
+    if (parent >= 0) {
+      double best = std::numeric_limits<double>::max();
+      for (int e = adjacency.offsets[parent]; e < adjacency.offsets[parent + 1]; ++e) {
+        if (adjacency.targets[e] == node && cost(e) < best) {
+          best = cost(e);
+          edge = adjacency.edge_ids[e];
         }
       }
-      
-      std::tuple<int, int, double> path(-1, -1, std::numeric_limits<double>::max());
-      double total_cost = std::numeric_limits<double>::max();
-      if (prev[end_node] != -1) {
-        int node = end_node;
-        total_cost = 0.0;
-        while (node != start_node) {
-          int from = prev[node];
-          double cost = costs[node] - costs[from];
-          total_cost += cost;
-          node = from;
+    }
+    nodes.push_back(node);
+    edges.push_back(edge);
+  }
+  std::reverse(nodes.begin() + first, nodes.end());
+  std::reverse(edges.begin() + first, edges.end());
+  paths.length[row] = static_cast<int>(nodes.size() - first);
+}
+
+// Bidirectional Dijkstra: a forward search from start_node and a backward
+// search on the reverse adjacency from end_node, always advancing the side
+// with the smaller queue key. The search stops once the two smallest keys add
+// up to at least the best path found, which is then optimal.
+template <typename Cost>
+std::tuple<int, int, double> _bidirectional_dijkstra(const Graph::Adjacency& forward_adjacency, const Graph::Adjacency& reverse_adjacency,
+                                                     const Cost& forward_cost, const Cost& reverse_cost, int start_node, int end_node,
+                                                     SearchWorkspace& forward, SearchWorkspace& backward) {
+  if (start_node == end_node) {
+    return std::make_tuple(start_node, end_node, 0.0);
+  }
+  
+  const Graph::Adjacency* adjacency[2] = {&forward_adjacency, &reverse_adjacency};
+  const Cost* costs[2] = {&forward_cost, &reverse_cost};
+  SearchWorkspace* search[2] = {&forward, &backward};
+  forward.reset();
+  backward.reset();
+  forward.update(start_node, 0.0);
+  backward.update(end_node, 0.0);
+  forward.push(0.0, start_node);
+  backward.push(0.0, end_node);
+  
+  double best = std::numeric_limits<double>::max();
+  while (!forward.empty() && !backward.empty()) {
+    if (forward.top().first + backward.top().first >= best) {
+      break;
+    }
+    
+    int side = forward.top().first <= backward.top().first ? 0 : 1;
+    SearchWorkspace& current = *search[side];
+    const SearchWorkspace& other = *search[1 - side];
+    double current_cost = current.top().first;
+    int current_node = current.top().second;
+    current.pop();
+    
+    if (current_cost > current.cost(current_node)) {
+      continue;
+    }
+    
+    const Graph::Adjacency& adj = *adjacency[side];
+    const Cost& cost = *costs[side];
+    for (int e = adj.offsets[current_node]; e < adj.offsets[current_node + 1]; ++e) {
+      int to = adj.targets[e];
+      double new_cost = current_cost + cost(e);
+      if (new_cost < current.cost(to)) {
+        current.update(to, new_cost, current_node);
+        current.push(new_cost, to);
+        
+        // Meeting point of both searches
+        double other_cost = other.cost(to);
+        if (other_cost < std::numeric_limits<double>::max() && new_cost + other_cost < best) {
+          best = new_cost + other_cost;
         }
-        path = std::make_tuple(start_node, end_node, total_cost);
       }
-      
-      result[i][j] = path;
     }
   }
   
-  return result;
+  if (best < std::numeric_limits<double>::max()) {
+    return std::make_tuple(start_node, end_node, best);
+  }
+  return std::make_tuple(-1, -1, std::numeric_limits<double>::max());
 }
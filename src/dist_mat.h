@@ -2,15 +2,112 @@
 #define DISTMAT_H
 
 #include "graph.h"
+#include "search_workspace.h"
+#include "search_policies.h"
+#include "parallel.h"
 #include <vector>
 #include <tuple>
 #include <string>
+#include <limits>
+#include <cstddef>
+#include <cmath>
 
-// RcppParallel methods
-std::vector<std::vector<std::tuple<int, int, double>>> parallelCalculateDistMat(
-    const Graph& graph, const std::vector<int>& start_nodes, const std::vector<int>& end_nodes, const std::string& mode);
+// Output of a distance matrix, written in place by the workers into memory
+// owned by the caller (e.g. R vectors). In the column layout, row
+// i * end_nodes.size() + j holds start_nodes[i], end_nodes[j] and their cost,
+// or -1, -1 and max() if the end node cannot be reached. In the matrix layout,
+// cell i + j * start_nodes.size() of a column-major matrix holds the cost, or
+// missing if the end node cannot be reached; integer matrices hold the cost
+// times scale, rounded (missing if it does not fit into an int).
+struct DistMatOutput {
+  int* start;
+  int* end;
+  double* cost;
+  int* cost_int;
+  double scale;
+  double missing;
+  int missing_int;
+  std::size_t start_stride;
+  std::size_t end_stride;
+  
+  static DistMatOutput columns(int* start, int* end, double* cost, std::size_t end_count);
+  static DistMatOutput matrix(double* cost, std::size_t start_count, double missing);
+  static DistMatOutput integer_matrix(int* cost, std::size_t start_count, double scale, int missing);
+  
+  // View of the cells of the start node with index i
+  DistMatOutput row(std::size_t i) const {
+    DistMatOutput view = *this;
+    std::size_t first = i * start_stride;
+    if (start) {
+      view.start += first;
+      view.end += first;
+    }
+    if (cost) {
+      view.cost += first;
+    } else {
+      view.cost_int += first;
+    }
+    return view;
+  }
+  void set(std::size_t j, int start_node, int end_node, double value) const {
+    std::size_t k = j * end_stride;
+    if (start) {
+      start[k] = start_node;
+      end[k] = end_node;
+    }
+    if (cost) {
+      cost[k] = value;
+    } else {
+      double rounded = std::floor(value * scale + 0.5);
+      cost_int[k] = rounded < std::numeric_limits<int>::max() ? static_cast<int>(rounded) : missing_int;
+    }
+  }
+  void set_unreachable(std::size_t j) const {
+    if (start) {
+      set(j, -1, -1, std::numeric_limits<double>::max());
+    } else if (cost) {
+      cost[j * end_stride] = missing;
+    } else {
+      cost_int[j * end_stride] = missing_int;
+    }
+  }
+};
 
-// Internal methods
-std::vector<std::vector<std::tuple<int, int, double>>> _dist_mat(const Graph& graph, const std::vector<int>& start_nodes, const std::vector<int>& end_nodes, const std::string& mode);
+// Routes of the rows of a distance matrix, collected per start node by the
+// workers. The route of row i * end_nodes.size() + j has length[row] nodes,
+// stored after those of the earlier rows of start node i in nodes[i]; edges[i]
+// holds the input edge by which each node is reached (-1 for the start node).
+// Unreachable end nodes have an empty route.
+struct DistMatPaths {
+  std::vector<int> length;
+  std::vector<std::vector<int>> nodes;
+  std::vector<std::vector<int>> edges;
+  
+  // Total number of route nodes
+  std::size_t size() const;
+  
+  // Flat layout, copied in parallel: the route of a row is stored at
+  // offsets[row] .. offsets[row + 1] - 1 of node and edge, which hold size()
+  // entries each
+  void flatten(int* offsets, int* node, int* edge) const;
+};
+
+// Parallel methods
+// The metric is dispatched once per call to search kernels compiled per cost
+// and heuristic policy (see search_policies.h). The A* engine's heuristic is
+// "alt" (landmarks), "euclidean" or "none". If paths is given, the Dijkstra
+// and A* engines also collect the route of every row from their search trees;
+// if stats is given, they also count the work of every start node into
+// (*stats)[i], for all end nodes of start node i together. Without paths, the
+// Dijkstra engine reads the search trees of the graph's tree cache if it is
+// enabled, and the statistics count only the work of growing them. The start
+// nodes are scheduled at the grain of schedule, and its monitor may cancel the run.
+void parallelCalculateDistMat(
+    const Graph& graph, int profile, const std::vector<int>& start_nodes, const std::vector<int>& end_nodes, const Metric& metric,
+    const std::string& engine, const std::string& heuristic, const DistMatOutput& out, DistMatPaths* paths = nullptr,
+    std::vector<QueryStats>* stats = nullptr, const parallel::Schedule& schedule = parallel::Schedule());
+std::vector<std::tuple<int, int, double>> parallelCalculatePairwise(
+    const Graph& graph, int profile, const std::vector<int>& start_nodes, const std::vector<int>& end_nodes, const Metric& metric,
+    const std::string& engine = "bidirectional");
 
 #endif // DISTMAT_H
@@ -1,10 +1,63 @@
 #include "graph.h"
+#include "contraction_hierarchy.h"
+#include "landmarks.h"
+#include "spatial_index.h"
+#include "search_workspace.h"
+#include "tree_cache.h"
+#include "parallel.h"
 #include <algorithm>
 #include <stdexcept>
-#include <map>
 #include <unordered_map>
+#include <limits>
+#include <cmath>
 
-// Constructor
+namespace {
+
+// Travel time in minutes of an edge with a length in m and a speed in km/h
+Graph::Weight travel_time(double length, double speed) {
+  return static_cast<Graph::Weight>((length / 1000.0) / (speed / 3600.0) / 60);
+}
+
+// Position of cell (x, y) along the Hilbert curve through a 2^16 x 2^16 grid
+std::uint64_t hilbert_index(std::uint32_t x, std::uint32_t y) {
+  const std::uint32_t side = 1u << 16;
+  std::uint64_t d = 0;
+  for (std::uint32_t s = side / 2; s > 0; s /= 2) {
+    std::uint32_t rx = (x & s) > 0;
+    std::uint32_t ry = (y & s) > 0;
+    d += static_cast<std::uint64_t>(s) * s * ((3 * rx) ^ ry);
+    
+    // Rotate the quadrant so that the curve continues in the right direction
+    if (ry == 0) {
+      if (rx == 1) {
+        x = side - 1 - x;
+        y = side - 1 - y;
+      }
+      std::swap(x, y);
+    }
+  }
+  return d;
+}
+
+}
+
+// Parallel worker building routing profiles, one per index
+class ProfileBuildWorker : public parallel::Worker {
+public:
+  explicit ProfileBuildWorker(Graph& graph) : graph_(graph) {}
+  
+  void operator()(std::size_t begin, std::size_t end) {
+    for (std::size_t profile = begin; profile < end; ++profile) {
+      graph_.build_profile(static_cast<int>(profile));
+    }
+  }
+  
+private:
+  Graph& graph_;
+};
+
+
+// Constructors
 Graph::Graph(const std::vector<std::string>& edge_from,
              const std::vector<std::string>& edge_to,
              const std::vector<double>& edge_speed,
@@ -13,78 +66,157 @@ Graph::Graph(const std::vector<std::string>& edge_from,
              const std::vector<std::string>& node_name,
              const std::vector<double>& node_x,
              const std::vector<double>& node_y,
-             const std::string& crs) 
-  : crs_(crs){
+             const std::string& crs,
+             NodeOrder order,
+             bool directed) 
+  : Graph(make_arrays(edge_from, edge_to, edge_speed, edge_length, edge_oneway, node_name, node_x, node_y), crs, order, directed) {}
+
+Graph::Graph(Arrays&& arrays, const std::string& crs, NodeOrder order, bool directed)
+  : crs_(crs), directed_(directed) {
   // Set profile to default
-  active_profile_ = "default";
+  active_profile_ = ROUTING_PROFILE_DEFAULT;
   
-  // Create a temporary node dictionary from node_name (name, id, valid)
-  std::unordered_map<std::string, std::pair<int, bool>> tmp_node_dict;
-  for (size_t i = 0; i < node_name.size(); ++i) {
-    tmp_node_dict[node_name[i]] = {static_cast<int>(i), false};
+  size_t n = arrays.node_x.size();
+  size_t m = arrays.edge_from.size();
+  if (arrays.node_y.size() != n || arrays.name_offsets.size() != n + 1 ||
+      arrays.name_offsets[n] != arrays.name_chars.size() ||
+      arrays.edge_to.size() != m || arrays.edge_speed.size() != m ||
+      arrays.edge_length.size() != m || arrays.edge_oneway.size() != m) {
+    throw std::runtime_error("Graph arrays have inconsistent lengths.");
   }
   
-  // Fill in edges vector
-  size_t m = edge_from.size();
-  edges_.reserve(m);
-  original_edges_.reserve(m);
-  for(size_t i = 0; i < m; ++i) {
-    auto from_it = tmp_node_dict.find(edge_from[i]);
-    auto to_it = tmp_node_dict.find(edge_to[i]);
-    if (from_it == tmp_node_dict.end() || to_it == tmp_node_dict.end()) {
+  // Every edge must connect known nodes and every node must be part of an edge
+  std::vector<bool> node_valid(n, false);
+  for (size_t i = 0; i < m; ++i) {
+    int from = arrays.edge_from[i];
+    int to = arrays.edge_to[i];
+    if (from < 0 || static_cast<size_t>(from) >= n || to < 0 || static_cast<size_t>(to) >= n) {
       throw std::runtime_error("All nodes must be part of edges.");
     }
-    
-    int from = from_it->second.first;
-    int to = to_it->second.first;
-    double speed = edge_speed[i];
-    double length = edge_length[i];
-    double cost = (length / 1000.0) / (speed / 3600.0) / 60;
-    std::string oneway = edge_oneway[i];
-    
-    Edge edge = {from, to, cost, speed, length, oneway};
-    edges_.emplace_back(edge);
-    original_edges_.emplace_back(edge);
-    
-    // Mark nodes as part of edges
-    from_it->second.second = true;
-    to_it->second.second = true;
-  }
-  
-  // Build the final node dictionary and fill in nodes vector
-  nodes_.reserve(node_name.size());
-  original_nodes_.reserve(node_name.size());
-  for (const auto& entry : tmp_node_dict) {
-    if (entry.second.second) {
-      int nodeId = entry.second.first;
-      original_node_dict_[nodeId] = entry.first;
-      node_dict_[nodeId] = entry.first;
-      Node node = {nodeId, node_x[nodeId], node_y[nodeId]};
-      nodes_.emplace_back(node);
-      original_nodes_.emplace_back(node);
-    } else {
+    node_valid[from] = true;
+    node_valid[to] = true;
+  }
+  for (size_t i = 0; i < n; ++i) {
+    if (!node_valid[i]) {
       throw std::runtime_error("All nodes must be part of edges.");
     }
   }
   
-  // Sort nodes and original_nodes vectors by id
-  auto sortById = [](const Node& a, const Node& b) { return a.id < b.id; };
-  std::sort(nodes_.begin(), nodes_.end(), sortById);
-  std::sort(original_nodes_.begin(), original_nodes_.end(), sortById);
+  renumber_nodes(arrays, order);
+  
+  edges_.from = std::move(arrays.edge_from);
+  edges_.to = std::move(arrays.edge_to);
+  edges_.speed = std::move(arrays.edge_speed);
+  edges_.length = std::move(arrays.edge_length);
+  edges_.oneway = std::move(arrays.edge_oneway);
+  node_x_ = std::move(arrays.node_x);
+  node_y_ = std::move(arrays.node_y);
+  name_offsets_ = std::move(arrays.name_offsets);
+  name_chars_ = std::move(arrays.name_chars);
+  workspaces_ = std::make_shared<WorkspacePool>(node_count());
+  
+  // Precompute all routing profiles; they are independent of each other
+  ProfileBuildWorker worker(*this);
+  parallel::parallelFor(0, ROUTING_PROFILE_COUNT, worker);
+}
+
+
+// Oneway codes
+Graph::Oneway Graph::parse_oneway(const std::string& oneway) {
+  if (oneway == "FT") return ONEWAY_FT;
+  if (oneway == "TF") return ONEWAY_TF;
+  if (oneway == "B") return ONEWAY_B;
+  if (oneway == "N") return ONEWAY_N;
+  if (oneway == "foot_only") return ONEWAY_FOOT_ONLY;
+  throw std::runtime_error("Invalid oneway value: " + oneway);
+}
+
+std::string Graph::oneway_name(Oneway oneway) {
+  switch (oneway) {
+  case ONEWAY_FT:
+    return "FT";
+  case ONEWAY_TF:
+    return "TF";
+  case ONEWAY_B:
+    return "B";
+  case ONEWAY_N:
+    return "N";
+  case ONEWAY_FOOT_ONLY:
+    return "foot_only";
+  }
+  throw std::runtime_error("Invalid oneway value.");
+}
+
+Graph::NodeOrder Graph::parse_node_order(const std::string& order) {
+  if (order == "input") return NODE_ORDER_INPUT;
+  if (order == "hilbert") return NODE_ORDER_HILBERT;
+  if (order == "bfs") return NODE_ORDER_BFS;
+  throw std::runtime_error("Invalid node order: " + order);
 }
 
 
 // Getters
-const std::vector<Graph::Edge>& Graph::edges() const {
-  return edges_;
+std::vector<Graph::Edge> Graph::edges() const {
+  return edges(active_profile_);
+}
+
+// Edges as they are routed in the profile: "TF" edges are reversed, "B"
+// edges (and all edges of an undirected graph) are listed in both directions
+// and "N" edges are dropped
+std::vector<Graph::Edge> Graph::edges(int profile) const {
+  const Profile& p = this->profile(profile);
+  
+  std::vector<Edge> result;
+  result.reserve(p.forward_adjacency.targets.size());
+  for (size_t i = 0; i < edges_.from.size(); ++i) {
+    double speed;
+    Oneway oneway;
+    profile_edge(profile, i, speed, oneway);
+    double length = edges_.length[i];
+    double cost = travel_time(length, speed);
+    Edge edge = {edges_.from[i], edges_.to[i], cost, speed, length, oneway};
+    
+    bool forward;
+    bool backward;
+    edge_directions(profile, oneway, forward, backward);
+    if (forward) {
+      result.push_back(edge);
+    }
+    if (backward) {
+      std::swap(edge.from, edge.to);
+      result.push_back(edge);
+    }
+  }
+  
+  return result;
+}
+
+std::vector<Graph::Node> Graph::nodes() const {
+  return nodes(active_profile_);
+}
+
+// Nodes that are connected to at least one edge of the profile
+std::vector<Graph::Node> Graph::nodes(int profile) const {
+  const Profile& p = this->profile(profile);
+  
+  std::vector<Node> result;
+  result.reserve(node_x_.size());
+  for (size_t i = 0; i < node_x_.size(); ++i) {
+    if (p.node_used[i]) {
+      Node node = {static_cast<int>(i), node_x_[i], node_y_[i]};
+      result.push_back(node);
+    }
+  }
+  
+  return result;
 }
 
-const std::vector<Graph::Node>& Graph::nodes() const {
-  return nodes_;
+std::string Graph::node_name(int id) const {
+  return std::string(name_chars_.data() + name_offsets_[id], name_offsets_[id + 1] - name_offsets_[id]);
 }
 
-const std::map<int, std::string>& Graph::node_dict() const {
-  return node_dict_;
+int Graph::node_count() const {
+  return static_cast<int>(node_x_.size());
 }
 
 std::string Graph::crs() const {
@@ -92,118 +224,584 @@ std::string Graph::crs() const {
 }
 
 std::string Graph::active_profile() const {
+  switch (active_profile_) {
+  case ROUTING_PROFILE_FOOT:
+    return "foot";
+  case ROUTING_PROFILE_BICYCLE:
+    return "bicycle";
+  case ROUTING_PROFILE_CAR:
+    return "car";
+  default:
+    return "default";
+  }
+}
+
+int Graph::active_profile_id() const {
   return active_profile_;
 }
 
+const Graph::Adjacency& Graph::forward_adjacency(int profile) const {
+  return this->profile(profile).forward_adjacency;
+}
 
-// Methods
-void Graph::activate_routing_profile(int profile) {
-  reset_edges(); // Reset edges to the original data
-  reset_nodes(); // Reset nodes to the original data
-  reset_node_dict();  // Reset node_dict to the original data
+const Graph::Adjacency& Graph::reverse_adjacency(int profile) const {
+  const Adjacency& reverse_adjacency = this->profile(profile).reverse_adjacency;
+  if (reverse_adjacency.offsets.empty()) {
+    throw std::runtime_error("Reverse adjacency has not been prepared.");
+  }
+  return reverse_adjacency;
+}
+
+WorkspacePool& Graph::workspaces() const {
+  return *workspaces_;
+}
 
-  if(profile == ROUTING_PROFILE_DEFAULT) {
-    active_profile_ = "default";
+void Graph::set_tree_cache(std::size_t capacity) {
+  if (capacity == 0) {
+    tree_cache_.reset();
+  } else if (tree_cache_) {
+    tree_cache_->set_capacity(capacity);
   } else {
-    std::vector<Edge> updated_edges;
-    std::vector<Node> updated_nodes;
-    std::map<std::string, int> updated_node_dict;
-    std::vector<bool> updated_node_ids(nodes_.size(), false);
-
-    for (Edge& edge : edges_) {
-      bool add_edge = true;
-      bool add_reverse_edge = false;
-
-      switch (profile) {
-      case ROUTING_PROFILE_FOOT:
-        active_profile_ = "foot";
-        edge.oneway = (edge.speed > 90) ? "N" : "B";
-        edge.speed = 5;
-        break;
-      case ROUTING_PROFILE_BICYCLE:
-        active_profile_ = "bicycle";
-        edge.oneway = (edge.speed > 90) ? "N" : edge.oneway;
-        edge.speed = (edge.oneway == "foot_only") ? 4 : 15; // default 15 km/h; 4 km/h when walking is required
-        break;
-      case ROUTING_PROFILE_CAR:
-        active_profile_ = "car";
-        edge.oneway = (edge.oneway == "foot_only") ? "N" : edge.oneway;
-        break;
-      default:
-        throw std::runtime_error("Invalid routing profile.");
-      }
+    tree_cache_ = std::make_shared<TreeCache>(capacity);
+  }
+}
 
-      // Update the cost based on the new speed
-      edge.cost = (edge.length / 1000.0) / (edge.speed / 3600.0) / 60;
+TreeCache* Graph::tree_cache() const {
+  return tree_cache_.get();
+}
 
-      // Adjust for the oneway parameter
-      if (edge.oneway == "TF") {
-        std::swap(edge.from, edge.to);
-      } else if (edge.oneway == "B") {
-        add_reverse_edge = true;
-      } else if (edge.oneway == "N") {
-        add_edge = false;
-      }
 
-      if (add_edge) {
-        updated_edges.push_back(edge);
-        updated_node_ids[edge.from] = true;
-        updated_node_ids[edge.to] = true;
+// Methods
+void Graph::activate_routing_profile(int profile) {
+  this->profile(profile); // Validate the profile
+  active_profile_ = profile;
+}
 
-        if (add_reverse_edge) {
-          Edge reverse_edge = edge;
-          std::swap(reverse_edge.from, reverse_edge.to);
-          updated_edges.push_back(reverse_edge);
+void Graph::update_edge_speeds(const std::vector<int>& edge_ids, const std::vector<double>& speeds) {
+  if (edge_ids.size() != speeds.size()) {
+    throw std::runtime_error("Edge ids and speeds must have the same length.");
+  }
+  for (size_t k = 0; k < edge_ids.size(); ++k) {
+    if (edge_ids[k] < 0 || static_cast<size_t>(edge_ids[k]) >= edges_.from.size()) {
+      throw std::runtime_error("Invalid edge id.");
+    }
+    if (!(speeds[k] >= 0)) {
+      throw std::runtime_error("Negative speed is not allowed.");
+    }
+  }
+  
+  // Oneway rules and costs of the updated edges before the update, per profile
+  std::vector<Oneway> old_oneway(ROUTING_PROFILE_COUNT * edge_ids.size());
+  std::vector<Weight> old_cost(ROUTING_PROFILE_COUNT * edge_ids.size());
+  for (int profile = 0; profile < ROUTING_PROFILE_COUNT; ++profile) {
+    for (size_t k = 0; k < edge_ids.size(); ++k) {
+      double speed;
+      profile_edge(profile, edge_ids[k], speed, old_oneway[profile * edge_ids.size() + k]);
+      old_cost[profile * edge_ids.size() + k] = travel_time(edges_.length[edge_ids[k]], speed);
+    }
+  }
+  
+  Weight* edge_speed = edges_.speed.mutable_data();
+  for (size_t k = 0; k < edge_ids.size(); ++k) {
+    edge_speed[edge_ids[k]] = static_cast<Weight>(speeds[k]);
+  }
+  
+  bool weights_changed = false;
+  for (int profile = 0; profile < ROUTING_PROFILE_COUNT; ++profile) {
+    Profile& p = profiles_[profile];
+    bool topology_changed = false;
+    bool cost_changed = false;
+    for (size_t k = 0; k < edge_ids.size() && !topology_changed; ++k) {
+      double speed;
+      Oneway oneway;
+      profile_edge(profile, edge_ids[k], speed, oneway);
+      topology_changed = oneway != old_oneway[profile * edge_ids.size() + k];
+      cost_changed = cost_changed || travel_time(edges_.length[edge_ids[k]], speed) != old_cost[profile * edge_ids.size() + k];
+    }
+    if (topology_changed) {
+      rebuild_profile(profile);
+      continue;
+    }
+    
+    // Profiles with fixed speeds (foot and bicycle) usually keep all costs
+    if (!cost_changed) {
+      continue;
+    }
+    weights_changed = true;
+    
+    // Patch the arcs of the updated edges, which start at one of their
+    // endpoints. The reverse adjacency of an undirected graph then shares the
+    // patched forward arrays again.
+    Adjacency* adjacencies[2] = {&p.forward_adjacency, &p.reverse_adjacency};
+    for (Adjacency* adjacency : adjacencies) {
+      if (adjacency->offsets.empty() || (!directed_ && adjacency == &p.reverse_adjacency)) {
+        continue;
+      }
+      Weight* cost = adjacency->cost.mutable_data();
+      for (int edge : edge_ids) {
+        double speed;
+        Oneway oneway;
+        profile_edge(profile, edge, speed, oneway);
+        Weight edge_cost = travel_time(edges_.length[edge], speed);
+        int endpoints[2] = {edges_.from[edge], edges_.to[edge]};
+        for (int u : endpoints) {
+          for (int e = adjacency->offsets[u]; e < adjacency->offsets[u + 1]; ++e) {
+            if (adjacency->edge_ids[e] == edge) {
+              cost[e] = edge_cost;
+            }
+          }
         }
       }
     }
+    if (!directed_ && !p.reverse_adjacency.offsets.empty()) {
+      p.reverse_adjacency = p.forward_adjacency;
+    }
+    
+    // Distance-mode structures do not depend on speeds
+    p.landmarks[0].reset();
+    if (p.ch[0] && p.ch[0]->customizable()) {
+      p.ch[0]->customize(*this, profile);
+    } else {
+      p.ch[0].reset();
+    }
+  }
+  
+  // Cached trees may hold the old travel times
+  if (tree_cache_ && weights_changed) {
+    tree_cache_->clear();
+  }
+}
 
-    // Reassign node ids and update node_dict
-    int new_id = 0;
-    for (const auto& pair : original_node_dict_) {
-      int old_id = pair.first;
-      const std::string& key = pair.second;
-      if (updated_node_ids[old_id]) {
-        Node& old_node = nodes_[old_id];
-        Node new_node = old_node;
-        new_node.id = new_id;
-        updated_nodes.push_back(new_node);
-        updated_node_dict[key] = new_id;
-        new_id++;
-      }
+// Transpose of the forward adjacency; the arcs of every node are ordered by
+// source node. Every arc of an undirected graph has its reverse arc, so the
+// forward adjacency is its own transpose and its arrays are shared.
+void Graph::prepare_reverse_adjacency(int profile) {
+  this->profile(profile);
+  const Adjacency& forward_adjacency = profiles_[profile].forward_adjacency;
+  Adjacency& reverse_adjacency = profiles_[profile].reverse_adjacency;
+  if (!reverse_adjacency.offsets.empty()) {
+    return;
+  }
+  if (!directed_) {
+    reverse_adjacency = forward_adjacency;
+    return;
+  }
+  
+  int node_count = this->node_count();
+  size_t arc_count = forward_adjacency.targets.size();
+  
+  std::vector<int> in_offsets(node_count + 1, 0);
+  for (size_t e = 0; e < arc_count; ++e) {
+    in_offsets[forward_adjacency.targets[e] + 1]++;
+  }
+  for (int i = 0; i < node_count; ++i) {
+    in_offsets[i + 1] += in_offsets[i];
+  }
+  
+  std::vector<int> offsets = in_offsets;
+  std::vector<int> targets(arc_count);
+  std::vector<Weight> cost(arc_count);
+  std::vector<Weight> length(arc_count);
+  std::vector<int> edge_ids(arc_count);
+  
+  for (int u = 0; u < node_count; ++u) {
+    for (int e = forward_adjacency.offsets[u]; e < forward_adjacency.offsets[u + 1]; ++e) {
+      int in_pos = in_offsets[forward_adjacency.targets[e]]++;
+      targets[in_pos] = u;
+      cost[in_pos] = forward_adjacency.cost[e];
+      length[in_pos] = forward_adjacency.length[e];
+      edge_ids[in_pos] = forward_adjacency.edge_ids[e];
     }
+  }
+  
+  reverse_adjacency.offsets = std::move(offsets);
+  reverse_adjacency.targets = std::move(targets);
+  reverse_adjacency.cost = std::move(cost);
+  reverse_adjacency.length = std::move(length);
+  reverse_adjacency.edge_ids = std::move(edge_ids);
+}
 
-    // Update edge node ids
-    for (Edge& edge : updated_edges) {
-      std::string from_key = original_node_dict_[edge.from];
-      std::string to_key = original_node_dict_[edge.to];
+void Graph::prepare_contraction_hierarchy(int profile, const std::string& mode, bool customizable) {
+  this->profile(profile);
+  std::shared_ptr<ContractionHierarchy>& ch = profiles_[profile].ch[mode == "time" ? 0 : 1];
+  if (!ch || (customizable && !ch->customizable())) {
+    ch = std::make_shared<ContractionHierarchy>(*this, profile, mode, customizable);
+  }
+}
 
-      edge.from = updated_node_dict[from_key];
-      edge.to = updated_node_dict[to_key];
-    }
+const ContractionHierarchy& Graph::contraction_hierarchy(int profile, const std::string& mode) const {
+  const std::shared_ptr<ContractionHierarchy>& ch = this->profile(profile).ch[mode == "time" ? 0 : 1];
+  if (!ch) {
+    throw std::runtime_error("Contraction hierarchy has not been prepared.");
+  }
+  return *ch;
+}
+
+void Graph::prepare_landmarks(int profile, const std::string& mode, int count) {
+  this->profile(profile);
+  std::shared_ptr<const Landmarks>& landmarks = profiles_[profile].landmarks[mode == "time" ? 0 : 1];
+  if (!landmarks || landmarks->count() != std::min(count, node_count())) {
+    prepare_reverse_adjacency(profile);
+    landmarks = std::make_shared<const Landmarks>(*this, profile, mode, count);
+  }
+}
 
-    // Assign the updated data to the class members
-    edges_ = std::move(updated_edges);
-    nodes_ = std::move(updated_nodes);
+const Landmarks& Graph::landmarks(int profile, const std::string& mode) const {
+  const std::shared_ptr<const Landmarks>& landmarks = this->profile(profile).landmarks[mode == "time" ? 0 : 1];
+  if (!landmarks) {
+    throw std::runtime_error("Landmarks have not been prepared.");
+  }
+  return *landmarks;
+}
 
-    // Create a new node_dict_ from updated_node_dict
-    node_dict_.clear();
-    for (const auto& pair : updated_node_dict) {
-      node_dict_[pair.second] = pair.first;
-    }
+void Graph::prepare_spatial_index(int profile) {
+  this->profile(profile);
+  std::shared_ptr<const SpatialIndex>& index = profiles_[profile].spatial_index;
+  if (!index) {
+    index = std::make_shared<const SpatialIndex>(*this, profile);
   }
 }
 
+const SpatialIndex& Graph::spatial_index(int profile) const {
+  const std::shared_ptr<const SpatialIndex>& index = this->profile(profile).spatial_index;
+  if (!index) {
+    throw std::runtime_error("Spatial index has not been prepared.");
+  }
+  return *index;
+}
+
 
 // Helper methods
-void Graph::reset_edges() {
-  edges_ = original_edges_;
+// Assign node ids in input order and look up the edge endpoints by name
+Graph::Arrays Graph::make_arrays(const std::vector<std::string>& edge_from,
+                                 const std::vector<std::string>& edge_to,
+                                 const std::vector<double>& edge_speed,
+                                 const std::vector<double>& edge_length,
+                                 const std::vector<std::string>& edge_oneway,
+                                 const std::vector<std::string>& node_name,
+                                 const std::vector<double>& node_x,
+                                 const std::vector<double>& node_y) {
+  // Create a temporary node dictionary from node_name (name, id)
+  std::unordered_map<std::string, int> tmp_node_dict;
+  tmp_node_dict.reserve(node_name.size());
+  for (size_t i = 0; i < node_name.size(); ++i) {
+    tmp_node_dict[node_name[i]] = static_cast<int>(i);
+  }
+  
+  Arrays arrays;
+  size_t m = edge_from.size();
+  arrays.edge_from.reserve(m);
+  arrays.edge_to.reserve(m);
+  arrays.edge_speed.reserve(m);
+  arrays.edge_length.reserve(m);
+  arrays.edge_oneway.reserve(m);
+  for(size_t i = 0; i < m; ++i) {
+    auto from_it = tmp_node_dict.find(edge_from[i]);
+    auto to_it = tmp_node_dict.find(edge_to[i]);
+    if (from_it == tmp_node_dict.end() || to_it == tmp_node_dict.end()) {
+      throw std::runtime_error("All nodes must be part of edges.");
+    }
+    
+    arrays.edge_from.push_back(from_it->second);
+    arrays.edge_to.push_back(to_it->second);
+    arrays.edge_speed.push_back(static_cast<Weight>(edge_speed[i]));
+    arrays.edge_length.push_back(static_cast<Weight>(edge_length[i]));
+    arrays.edge_oneway.push_back(parse_oneway(edge_oneway[i]));
+  }
+  
+  // Nodes: coordinates and the concatenated name table
+  arrays.node_x = node_x;
+  arrays.node_y = node_y;
+  arrays.name_offsets.assign(node_name.size() + 1, 0);
+  for (size_t i = 0; i < node_name.size(); ++i) {
+    arrays.name_offsets[i + 1] = arrays.name_offsets[i] + node_name[i].size();
+  }
+  arrays.name_chars.reserve(arrays.name_offsets.back());
+  for (const std::string& name : node_name) {
+    arrays.name_chars.insert(arrays.name_chars.end(), name.begin(), name.end());
+  }
+  
+  return arrays;
+}
+
+// Renumber the nodes of valid arrays: the node and name arrays are permuted
+// and the edge endpoints mapped to the new ids, the edges keep their order
+void Graph::renumber_nodes(Arrays& arrays, NodeOrder order) {
+  size_t n = arrays.node_x.size();
+  if (order == NODE_ORDER_INPUT || n == 0) {
+    return;
+  }
+  
+  // old_id[i] is the input id of the node that gets id i
+  std::vector<int> old_id(n);
+  if (order == NODE_ORDER_HILBERT) {
+    // Scale the bounding box of the finite coordinates to the curve's grid
+    double min_x = std::numeric_limits<double>::infinity(), max_x = -min_x;
+    double min_y = min_x, max_y = max_x;
+    for (size_t i = 0; i < n; ++i) {
+      if (std::isfinite(arrays.node_x[i]) && std::isfinite(arrays.node_y[i])) {
+        min_x = std::min(min_x, arrays.node_x[i]);
+        max_x = std::max(max_x, arrays.node_x[i]);
+        min_y = std::min(min_y, arrays.node_y[i]);
+        max_y = std::max(max_y, arrays.node_y[i]);
+      }
+    }
+    double scale = 65535.0 / std::max(std::max(max_x - min_x, max_y - min_y), 1e-300);
+    std::vector<std::pair<std::uint64_t, int>> keys(n);
+    for (size_t i = 0; i < n; ++i) {
+      double x = (arrays.node_x[i] - min_x) * scale;
+      double y = (arrays.node_y[i] - min_y) * scale;
+      keys[i].first = std::isfinite(x) && std::isfinite(y)
+        ? hilbert_index(static_cast<std::uint32_t>(x), static_cast<std::uint32_t>(y))
+        : std::numeric_limits<std::uint64_t>::max();
+      keys[i].second = static_cast<int>(i);
+    }
+    std::sort(keys.begin(), keys.end());
+    for (size_t i = 0; i < n; ++i) {
+      old_id[i] = keys[i].second;
+    }
+  } else {
+    // Breadth-first over the undirected edges, one component after the other
+    std::vector<int> offsets(n + 1, 0);
+    for (size_t i = 0; i < arrays.edge_from.size(); ++i) {
+      offsets[arrays.edge_from[i] + 1]++;
+      offsets[arrays.edge_to[i] + 1]++;
+    }
+    for (size_t u = 0; u < n; ++u) {
+      offsets[u + 1] += offsets[u];
+    }
+    std::vector<int> neighbours(offsets[n]);
+    std::vector<int> position(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < arrays.edge_from.size(); ++i) {
+      neighbours[position[arrays.edge_from[i]]++] = arrays.edge_to[i];
+      neighbours[position[arrays.edge_to[i]]++] = arrays.edge_from[i];
+    }
+    
+    std::vector<bool> visited(n, false);
+    size_t head = 0;
+    size_t tail = 0;
+    for (size_t root = 0; root < n; ++root) {
+      if (visited[root]) {
+        continue;
+      }
+      visited[root] = true;
+      old_id[tail++] = static_cast<int>(root);
+      while (head < tail) {
+        int u = old_id[head++];
+        for (int e = offsets[u]; e < offsets[u + 1]; ++e) {
+          if (!visited[neighbours[e]]) {
+            visited[neighbours[e]] = true;
+            old_id[tail++] = neighbours[e];
+          }
+        }
+      }
+    }
+  }
+  
+  std::vector<int> new_id(n);
+  for (size_t i = 0; i < n; ++i) {
+    new_id[old_id[i]] = static_cast<int>(i);
+  }
+  for (size_t i = 0; i < arrays.edge_from.size(); ++i) {
+    arrays.edge_from[i] = new_id[arrays.edge_from[i]];
+    arrays.edge_to[i] = new_id[arrays.edge_to[i]];
+  }
+  
+  std::vector<double> node_x(n);
+  std::vector<double> node_y(n);
+  std::vector<std::uint64_t> name_offsets(n + 1, 0);
+  std::vector<char> name_chars;
+  name_chars.reserve(arrays.name_chars.size());
+  for (size_t i = 0; i < n; ++i) {
+    int old = old_id[i];
+    node_x[i] = arrays.node_x[old];
+    node_y[i] = arrays.node_y[old];
+    name_chars.insert(name_chars.end(), arrays.name_chars.begin() + arrays.name_offsets[old],
+                      arrays.name_chars.begin() + arrays.name_offsets[old + 1]);
+    name_offsets[i + 1] = name_chars.size();
+  }
+  arrays.node_x = std::move(node_x);
+  arrays.node_y = std::move(node_y);
+  arrays.name_offsets = std::move(name_offsets);
+  arrays.name_chars = std::move(name_chars);
+}
+
+const Graph::Profile& Graph::profile(int profile) const {
+  if (profile < 0 || profile >= ROUTING_PROFILE_COUNT) {
+    throw std::runtime_error("Invalid routing profile.");
+  }
+  return profiles_[profile];
 }
 
-void Graph::reset_nodes() {
-  nodes_ = original_nodes_;
+// Speed and oneway rule of an input edge in a routing profile
+void Graph::profile_edge(int profile, std::size_t edge, double& speed, Oneway& oneway) const {
+  speed = edges_.speed[edge];
+  oneway = edges_.oneway[edge];
+  profile_rules(profile, speed, oneway);
 }
 
-void Graph::reset_node_dict() {
-  node_dict_ = original_node_dict_;
-}
\ No newline at end of file
+// Speed and oneway rule of an edge in a profile, from its input speed and
+// oneway rule. A slower edge is never closed where a faster one is open.
+void Graph::profile_rules(int profile, double& speed, Oneway& oneway) {
+  switch (profile) {
+  case ROUTING_PROFILE_DEFAULT:
+    break;
+  case ROUTING_PROFILE_FOOT:
+    oneway = (speed > 90) ? ONEWAY_N : ONEWAY_B;
+    speed = 5;
+    break;
+  case ROUTING_PROFILE_BICYCLE:
+    oneway = (speed > 90) ? ONEWAY_N : oneway;
+    speed = (oneway == ONEWAY_FOOT_ONLY) ? 4 : 15; // default 15 km/h; 4 km/h when walking is required
+    break;
+  case ROUTING_PROFILE_CAR:
+    oneway = (oneway == ONEWAY_FOOT_ONLY) ? ONEWAY_N : oneway;
+    break;
+  default:
+    throw std::runtime_error("Invalid routing profile.");
+  }
+}
+
+std::vector<std::pair<int, int>> Graph::routable_edges(int profile) const {
+  this->profile(profile);
+  std::vector<std::pair<int, int>> result;
+  result.reserve(edges_.from.size());
+  for (size_t i = 0; i < edges_.from.size(); ++i) {
+    // Speed 0 opens every edge that any speed opens
+    double speed = 0;
+    Oneway oneway = edges_.oneway[i];
+    profile_rules(profile, speed, oneway);
+    
+    bool forward;
+    bool backward;
+    edge_directions(profile, oneway, forward, backward);
+    if (forward || backward) {
+      result.push_back(std::make_pair(edges_.from[i], edges_.to[i]));
+    }
+  }
+  return result;
+}
+
+// Directions in which a profile routes an edge with a oneway rule. The default
+// profile routes every edge as given; an undirected graph routes an edge both
+// ways if it routes it at all, as if it held a reversed copy of the edge.
+void Graph::edge_directions(int profile, Oneway oneway, bool& forward, bool& backward) const {
+  forward = true;
+  backward = false;
+  if (profile != ROUTING_PROFILE_DEFAULT) {
+    forward = oneway != ONEWAY_TF && oneway != ONEWAY_N;
+    backward = oneway == ONEWAY_TF || oneway == ONEWAY_B;
+  }
+  if (!directed_ && (forward || backward)) {
+    forward = true;
+    backward = true;
+  }
+}
+
+// Rebuild a profile from the input edges, dropping everything derived from it
+void Graph::rebuild_profile(int profile) {
+  Profile& p = profiles_[profile];
+  bool reverse = !p.reverse_adjacency.offsets.empty();
+  std::shared_ptr<ContractionHierarchy> customizable[2];
+  for (int mode = 0; mode < 2; ++mode) {
+    if (p.ch[mode] && p.ch[mode]->customizable()) {
+      customizable[mode] = p.ch[mode];
+    }
+  }
+  p = Profile();
+  build_profile(profile);
+  if (tree_cache_) {
+    tree_cache_->clear();
+  }
+  if (reverse) {
+    prepare_reverse_adjacency(profile);
+  }
+  
+  // Customizable hierarchies span every routable edge, so the new arcs fit
+  // their topology and only their weights are re-computed
+  for (int mode = 0; mode < 2; ++mode) {
+    if (customizable[mode]) {
+      customizable[mode]->customize(*this, profile);
+      p.ch[mode] = customizable[mode];
+    }
+  }
+}
+
+void Graph::build_profile(int profile) {
+  Profile& p = profiles_[profile];
+  int node_count = this->node_count();
+  size_t m = edges_.from.size();
+  
+  std::vector<std::uint8_t> node_used(node_count, 0);
+  
+  // Arcs yielded by the edges in this profile
+  std::vector<int> arc_from;
+  std::vector<int> arc_to;
+  std::vector<int> arc_edge;
+  std::vector<Weight> edge_cost(m);
+  size_t arc_capacity = directed_ ? m : 2 * m;
+  arc_from.reserve(arc_capacity);
+  arc_to.reserve(arc_capacity);
+  arc_edge.reserve(arc_capacity);
+  
+  for (size_t i = 0; i < m; ++i) {
+    double speed;
+    Oneway oneway;
+    profile_edge(profile, i, speed, oneway);
+    edge_cost[i] = travel_time(edges_.length[i], speed);
+    
+    bool forward;
+    bool backward;
+    edge_directions(profile, oneway, forward, backward);
+    
+    int from = edges_.from[i];
+    int to = edges_.to[i];
+    if (forward) {
+      arc_from.push_back(from);
+      arc_to.push_back(to);
+      arc_edge.push_back(static_cast<int>(i));
+    }
+    if (backward) {
+      arc_from.push_back(to);
+      arc_to.push_back(from);
+      arc_edge.push_back(static_cast<int>(i));
+    }
+    if (forward || backward) {
+      node_used[from] = 1;
+      node_used[to] = 1;
+    }
+  }
+  
+  // Count the out-degree of every node
+  size_t arc_count = arc_edge.size();
+  std::vector<int> out_offsets(node_count + 1, 0);
+  for (size_t a = 0; a < arc_count; ++a) {
+    out_offsets[arc_from[a] + 1]++;
+  }
+  for (int i = 0; i < node_count; ++i) {
+    out_offsets[i + 1] += out_offsets[i];
+  }
+  
+  std::vector<int> offsets = out_offsets;
+  std::vector<int> targets(arc_count);
+  std::vector<Weight> cost(arc_count);
+  std::vector<Weight> length(arc_count);
+  std::vector<int> edge_ids(arc_count);
+  
+  // Scatter the arcs into their slots, keeping the input order per node
+  for (size_t a = 0; a < arc_count; ++a) {
+    int edge_id = arc_edge[a];
+    int out_pos = out_offsets[arc_from[a]]++;
+    targets[out_pos] = arc_to[a];
+    cost[out_pos] = edge_cost[edge_id];
+    length[out_pos] = edges_.length[edge_id];
+    edge_ids[out_pos] = edge_id;
+  }
+  
+  p.node_used = std::move(node_used);
+  p.forward_adjacency.offsets = std::move(offsets);
+  p.forward_adjacency.targets = std::move(targets);
+  p.forward_adjacency.cost = std::move(cost);
+  p.forward_adjacency.length = std::move(length);
+  p.forward_adjacency.edge_ids = std::move(edge_ids);
+}
@@ -3,11 +3,69 @@
 
 #include <vector>
 #include <string>
-#include <map>
+#include <memory>
+#include <utility>
+#include <cstdint>
+#include "buffer.h"
+
+class ContractionHierarchy;
+class Landmarks;
+class SpatialIndex;
+class WorkspacePool;
+class TreeCache;
 
 class Graph {
 public:
-  // Constructor
+  // Edge weights are stored as double unless GEOROUTER_FLOAT_WEIGHTS is
+  // defined, which halves the memory of the weight arrays
+#ifdef GEOROUTER_FLOAT_WEIGHTS
+  typedef float Weight;
+#else
+  typedef double Weight;
+#endif
+  
+  // Oneway codes: one-way from-to, one-way to-from, two-way, restricted and pedestrian only
+  enum Oneway : std::uint8_t {
+    ONEWAY_FT = 0,
+    ONEWAY_TF = 1,
+    ONEWAY_B = 2,
+    ONEWAY_N = 3,
+    ONEWAY_FOOT_ONLY = 4
+  };
+  static Oneway parse_oneway(const std::string& oneway);
+  static std::string oneway_name(Oneway oneway);
+  
+  // Orders of the internal node ids: input order, along a Hilbert curve over
+  // the node coordinates, or breadth-first over the edges. Nodes close to each
+  // other then get close ids, so the node and arc arrays a search touches
+  // share cache lines. Node names always keep referring to the same nodes.
+  enum NodeOrder : std::uint8_t {
+    NODE_ORDER_INPUT = 0,
+    NODE_ORDER_HILBERT = 1,
+    NODE_ORDER_BFS = 2
+  };
+  static NodeOrder parse_node_order(const std::string& order);
+  
+  // Input arrays of a graph whose node ids are already assigned: edge
+  // endpoints index the node arrays and the name of node i is
+  // name_chars[name_offsets[i] .. name_offsets[i + 1] - 1]
+  struct Arrays {
+    std::vector<int> edge_from;
+    std::vector<int> edge_to;
+    std::vector<Weight> edge_speed;
+    std::vector<Weight> edge_length;
+    std::vector<Oneway> edge_oneway;
+    std::vector<double> node_x;
+    std::vector<double> node_y;
+    std::vector<std::uint64_t> name_offsets;
+    std::vector<char> name_chars;
+  };
+  
+  // Constructors: from node names, or from arrays that are moved into the
+  // graph without copying. The node ids are renumbered in the given order
+  // before the graph is laid out. In an undirected graph, every edge that a
+  // profile routes at all is routed in both directions; the edge is still
+  // stored once.
   Graph(const std::vector<std::string>& edge_from,
         const std::vector<std::string>& edge_to,
         const std::vector<double>& edge_speed,
@@ -16,15 +74,24 @@ public:
         const std::vector<std::string>& node_name,
         const std::vector<double>& node_x,
         const std::vector<double>& node_y,
-        const std::string& crs);
+        const std::string& crs,
+        NodeOrder order = NODE_ORDER_INPUT,
+        bool directed = true);
+  Graph(Arrays&& arrays, const std::string& crs, NodeOrder order = NODE_ORDER_INPUT, bool directed = true);
+  
+  // Serialization: save writes a versioned binary file that load maps into
+  // memory, so the arrays of a loaded graph are views into the file
+  void save(const std::string& path) const;
+  static std::unique_ptr<Graph> load(const std::string& path);
   
+  // Edge as it is routed in a profile
   struct Edge {
     int from;
     int to;
     double cost;
     double speed;
     double length;
-    std::string oneway;
+    Oneway oneway;
   };
   
   struct Node {
@@ -33,37 +100,141 @@ public:
     double y;
   };
   
+  // Compressed sparse row adjacency: the arcs of node u are stored at
+  // positions offsets[u] .. offsets[u + 1] - 1 of the flat arrays.
+  // edge_ids holds the index of the input edge an arc was derived from.
+  struct Adjacency {
+    Buffer<int> offsets;
+    Buffer<int> targets;
+    Buffer<Weight> cost;
+    Buffer<Weight> length;
+    Buffer<int> edge_ids;
+  };
+  
   // Routing profiles
   static constexpr int ROUTING_PROFILE_DEFAULT = 0;
   static constexpr int ROUTING_PROFILE_FOOT = 1;
   static constexpr int ROUTING_PROFILE_BICYCLE = 2;
   static constexpr int ROUTING_PROFILE_CAR = 3;
+  static constexpr int ROUTING_PROFILE_COUNT = 4;
   
-  // Getters
-  const std::vector<Edge>& edges() const;
-  const std::vector<Node>& nodes() const;
-  const std::map<int, std::string>& node_dict() const;
+  // Getters (without a profile argument they refer to the active profile)
+  std::vector<Edge> edges() const;
+  std::vector<Edge> edges(int profile) const;
+  std::vector<Node> nodes() const;
+  std::vector<Node> nodes(int profile) const;
+  std::string node_name(int id) const;
+  double node_x(int id) const { return node_x_[id]; }
+  double node_y(int id) const { return node_y_[id]; }
+  int node_count() const;
+  // Number of input edges as stored, i.e. each undirected edge once
+  std::size_t edge_count() const { return edges_.from.size(); }
   std::string crs() const;
+  bool directed() const { return directed_; }
   std::string active_profile() const;
+  int active_profile_id() const;
+  const Adjacency& forward_adjacency(int profile) const;
+  const Adjacency& reverse_adjacency(int profile) const;
+  
+  // Node pairs of the input edges that a profile routes at some speed, in
+  // either direction. No speed update routes an edge outside of them, so a
+  // customizable contraction hierarchy built on them keeps its topology.
+  std::vector<std::pair<int, int>> routable_edges(int profile) const;
+  
+  // Search workspaces shared by the query kernels of all profiles
+  WorkspacePool& workspaces() const;
+  
+  // Opt-in cache of the shortest path trees of the Dijkstra engines, bounded
+  // to capacity bytes (0 disables it). Trees are keyed by profile, so they
+  // stay valid across profile activations; they are dropped whenever edge
+  // weights or a profile change. tree_cache() is nullptr while disabled.
+  void set_tree_cache(std::size_t capacity);
+  TreeCache* tree_cache() const;
   
   // Methods
   void activate_routing_profile(int profile);
   
+  // New speeds for some input edges: the arc costs of every profile are
+  // patched in place, time-mode landmarks are dropped and a customizable
+  // time-mode contraction hierarchy is re-customized (any other is dropped).
+  // A profile whose oneway rules change with the new speeds is rebuilt; its
+  // customizable hierarchies keep their topology and are re-customized. A
+  // profile whose costs do not change (e.g. foot and bicycle) is left as it is.
+  void update_edge_speeds(const std::vector<int>& edge_ids, const std::vector<double>& speeds);
+  
+  // Reverse adjacency of a profile, built on first use
+  void prepare_reverse_adjacency(int profile);
+  
+  // Contraction hierarchies of a profile ("time" or "distance" mode). An
+  // existing hierarchy is kept unless a customizable one is requested.
+  void prepare_contraction_hierarchy(int profile, const std::string& mode, bool customizable = false);
+  const ContractionHierarchy& contraction_hierarchy(int profile, const std::string& mode) const;
+  
+  // Landmarks for the ALT heuristic of a profile ("time" or "distance" mode)
+  void prepare_landmarks(int profile, const std::string& mode, int count);
+  const Landmarks& landmarks(int profile, const std::string& mode) const;
+  
+  // Grid over the node coordinates of a profile, for snapping points to nodes
+  void prepare_spatial_index(int profile);
+  const SpatialIndex& spatial_index(int profile) const;
+  
 private:
+  friend class ProfileBuildWorker;
+  
+  // Input edges, stored as one contiguous array per attribute
+  struct EdgeStore {
+    Buffer<int> from;
+    Buffer<int> to;
+    Buffer<Weight> speed;
+    Buffer<Weight> length;
+    Buffer<Oneway> oneway;
+  };
+  
+  // Adjacency of one routing profile over the shared edges and nodes. Node
+  // ids are the same in every profile; speeds and oneway rules of a profile
+  // are derived from the input edges on demand.
+  struct Profile {
+    Buffer<std::uint8_t> node_used;
+    Adjacency forward_adjacency;
+    Adjacency reverse_adjacency;
+    std::shared_ptr<ContractionHierarchy> ch[2];
+    std::shared_ptr<const Landmarks> landmarks[2];
+    std::shared_ptr<const SpatialIndex> spatial_index;
+  };
+  
   // Member variables
-  std::vector<Edge> edges_;
-  std::vector<Edge> original_edges_;
-  std::vector<Node> nodes_;
-  std::vector<Node> original_nodes_;
-  std::map<int, std::string> original_node_dict_;
-  std::map<int, std::string> node_dict_;
+  EdgeStore edges_;
+  Buffer<double> node_x_;
+  Buffer<double> node_y_;
+  // Node names, concatenated: the name of node i is name_chars_[name_offsets_[i] .. name_offsets_[i + 1] - 1]
+  Buffer<std::uint64_t> name_offsets_;
+  Buffer<char> name_chars_;
   std::string crs_;
-  std::string active_profile_;
+  bool directed_;
+  int active_profile_;
+  Profile profiles_[ROUTING_PROFILE_COUNT];
+  std::shared_ptr<WorkspacePool> workspaces_;
+  std::shared_ptr<TreeCache> tree_cache_;
+  
+  // Empty graph, filled in by load
+  Graph();
   
   // Helper methods
-  void reset_edges();
-  void reset_nodes();
-  void reset_node_dict();
+  static Arrays make_arrays(const std::vector<std::string>& edge_from,
+                            const std::vector<std::string>& edge_to,
+                            const std::vector<double>& edge_speed,
+                            const std::vector<double>& edge_length,
+                            const std::vector<std::string>& edge_oneway,
+                            const std::vector<std::string>& node_name,
+                            const std::vector<double>& node_x,
+                            const std::vector<double>& node_y);
+  static void renumber_nodes(Arrays& arrays, NodeOrder order);
+  const Profile& profile(int profile) const;
+  void profile_edge(int profile, std::size_t edge, double& speed, Oneway& oneway) const;
+  static void profile_rules(int profile, double& speed, Oneway& oneway);
+  void edge_directions(int profile, Oneway oneway, bool& forward, bool& backward) const;
+  void build_profile(int profile);
+  void rebuild_profile(int profile);
 };
 
 #endif //GRAPH_H
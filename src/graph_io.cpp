@@ -0,0 +1,223 @@
+#include "graph.h"
+#include "mapped_file.h"
+#include "search_workspace.h"
+#include <fstream>
+#include <stdexcept>
+#include <cstring>
+
+namespace {
+
+// Graph file layout: a fixed header followed by arrays. Every array is stored
+// as its element count (uint64) followed by its elements and padded to a
+// multiple of 8 bytes, so the arrays of a mapped file are aligned.
+const char GRAPH_FILE_MAGIC[8] = {'G', 'E', 'O', 'R', 'O', 'U', 'T', 'E'};
+const std::uint32_t GRAPH_FILE_VERSION = 1;
+const std::uint32_t GRAPH_FILE_BYTE_ORDER = 0x01020304;
+
+// Header flags; files without flags hold directed graphs
+const std::uint32_t GRAPH_FILE_UNDIRECTED = 1;
+
+struct GraphFileHeader {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t byte_order;
+  std::uint32_t weight_size;
+  std::uint32_t profile_count;
+  std::int32_t active_profile;
+  std::uint32_t flags;
+};
+
+class GraphFileWriter {
+public:
+  explicit GraphFileWriter(const std::string& path)
+    : out_(path.c_str(), std::ios::binary | std::ios::trunc), path_(path), offset_(0) {
+    if (!out_) {
+      throw std::runtime_error("Cannot write graph file: " + path);
+    }
+  }
+
+  void write(const void* data, std::size_t size) {
+    out_.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+    offset_ += size;
+  }
+
+  template <typename T>
+  void array(const T* data, std::size_t size) {
+    static const char padding[8] = {0};
+    std::uint64_t count = size;
+    write(&count, sizeof(count));
+    write(data, size * sizeof(T));
+    write(padding, (8 - offset_ % 8) % 8);
+  }
+
+  template <typename T>
+  void array(const Buffer<T>& buffer) {
+    array(buffer.data(), buffer.size());
+  }
+
+  void close() {
+    out_.close();
+    if (!out_) {
+      throw std::runtime_error("Cannot write graph file: " + path_);
+    }
+  }
+
+private:
+  std::ofstream out_;
+  std::string path_;
+  std::size_t offset_;
+};
+
+class GraphFileReader {
+public:
+  explicit GraphFileReader(const std::shared_ptr<const MappedFile>& file) : file_(file), offset_(0) {}
+
+  const char* read(std::size_t size) {
+    if (size > file_->size() - offset_) {
+      throw std::runtime_error("Truncated graph file.");
+    }
+    const char* data = file_->data() + offset_;
+    offset_ += size;
+    return data;
+  }
+
+  // View of the next array; no elements are copied
+  template <typename T>
+  Buffer<T> array() {
+    std::uint64_t count;
+    std::memcpy(&count, read(sizeof(count)), sizeof(count));
+    if (count > (file_->size() - offset_) / sizeof(T)) {
+      throw std::runtime_error("Truncated graph file.");
+    }
+    const T* data = reinterpret_cast<const T*>(read(static_cast<std::size_t>(count) * sizeof(T)));
+    read((8 - offset_ % 8) % 8);
+    return Buffer<T>(data, static_cast<std::size_t>(count), file_);
+  }
+
+private:
+  std::shared_ptr<const MappedFile> file_;
+  std::size_t offset_;
+};
+
+void check(bool condition) {
+  if (!condition) {
+    throw std::runtime_error("Corrupt graph file.");
+  }
+}
+
+}
+
+
+// Empty graph, filled in by load
+Graph::Graph() : directed_(true), active_profile_(ROUTING_PROFILE_DEFAULT) {}
+
+
+// Write the nodes, edges and the forward adjacency of every profile. Reverse
+// adjacencies, contraction hierarchies and landmarks are rebuilt on demand.
+void Graph::save(const std::string& path) const {
+  GraphFileWriter writer(path);
+
+  GraphFileHeader header;
+  std::memcpy(header.magic, GRAPH_FILE_MAGIC, sizeof(header.magic));
+  header.version = GRAPH_FILE_VERSION;
+  header.byte_order = GRAPH_FILE_BYTE_ORDER;
+  header.weight_size = sizeof(Weight);
+  header.profile_count = ROUTING_PROFILE_COUNT;
+  header.active_profile = active_profile_;
+  header.flags = directed_ ? 0 : GRAPH_FILE_UNDIRECTED;
+  writer.write(&header, sizeof(header));
+
+  writer.array(crs_.data(), crs_.size());
+
+  writer.array(node_x_);
+  writer.array(node_y_);
+  writer.array(name_offsets_);
+  writer.array(name_chars_);
+
+  writer.array(edges_.from);
+  writer.array(edges_.to);
+  writer.array(edges_.speed);
+  writer.array(edges_.length);
+  writer.array(edges_.oneway);
+
+  for (const Profile& p : profiles_) {
+    writer.array(p.node_used);
+    writer.array(p.forward_adjacency.offsets);
+    writer.array(p.forward_adjacency.targets);
+    writer.array(p.forward_adjacency.cost);
+    writer.array(p.forward_adjacency.length);
+    writer.array(p.forward_adjacency.edge_ids);
+  }
+
+  writer.close();
+}
+
+
+std::unique_ptr<Graph> Graph::load(const std::string& path) {
+  std::shared_ptr<const MappedFile> file = std::make_shared<const MappedFile>(path);
+  GraphFileReader reader(file);
+
+  GraphFileHeader header;
+  std::memcpy(&header, reader.read(sizeof(header)), sizeof(header));
+  if (std::memcmp(header.magic, GRAPH_FILE_MAGIC, sizeof(header.magic)) != 0) {
+    throw std::runtime_error("Not a graph file: " + path);
+  }
+  if (header.version != GRAPH_FILE_VERSION) {
+    throw std::runtime_error("Unsupported graph file version.");
+  }
+  if (header.byte_order != GRAPH_FILE_BYTE_ORDER) {
+    throw std::runtime_error("Graph file was written on a platform with a different byte order.");
+  }
+  if (header.weight_size != sizeof(Weight)) {
+    throw std::runtime_error("Graph file was written with a different weight precision.");
+  }
+  check(header.profile_count == ROUTING_PROFILE_COUNT);
+  check(header.active_profile >= 0 && header.active_profile < ROUTING_PROFILE_COUNT);
+  check((header.flags & ~GRAPH_FILE_UNDIRECTED) == 0);
+
+  std::unique_ptr<Graph> graph(new Graph());
+  graph->active_profile_ = header.active_profile;
+  graph->directed_ = (header.flags & GRAPH_FILE_UNDIRECTED) == 0;
+
+  Buffer<char> crs = reader.array<char>();
+  graph->crs_.assign(crs.data(), crs.size());
+
+  graph->node_x_ = reader.array<double>();
+  graph->node_y_ = reader.array<double>();
+  graph->name_offsets_ = reader.array<std::uint64_t>();
+  graph->name_chars_ = reader.array<char>();
+  std::size_t node_count = graph->node_x_.size();
+  check(graph->node_y_.size() == node_count);
+  check(graph->name_offsets_.size() == node_count + 1);
+  check(graph->name_offsets_[node_count] == graph->name_chars_.size());
+
+  EdgeStore& edges = graph->edges_;
+  edges.from = reader.array<int>();
+  edges.to = reader.array<int>();
+  edges.speed = reader.array<Weight>();
+  edges.length = reader.array<Weight>();
+  edges.oneway = reader.array<Oneway>();
+  std::size_t edge_count = edges.from.size();
+  check(edges.to.size() == edge_count && edges.speed.size() == edge_count &&
+        edges.length.size() == edge_count && edges.oneway.size() == edge_count);
+
+  for (Profile& p : graph->profiles_) {
+    Adjacency& adjacency = p.forward_adjacency;
+    p.node_used = reader.array<std::uint8_t>();
+    adjacency.offsets = reader.array<int>();
+    adjacency.targets = reader.array<int>();
+    adjacency.cost = reader.array<Weight>();
+    adjacency.length = reader.array<Weight>();
+    adjacency.edge_ids = reader.array<int>();
+
+    std::size_t arc_count = adjacency.targets.size();
+    check(p.node_used.size() == node_count);
+    check(adjacency.offsets.size() == node_count + 1);
+    check(adjacency.offsets[node_count] >= 0 && static_cast<std::size_t>(adjacency.offsets[node_count]) == arc_count);
+    check(adjacency.cost.size() == arc_count && adjacency.length.size() == arc_count &&
+          adjacency.edge_ids.size() == arc_count);
+  }
+
+  graph->workspaces_ = std::make_shared<WorkspacePool>(static_cast<int>(node_count));
+  return graph;
+}
@@ -0,0 +1,210 @@
+#ifndef HEAPS_H
+#define HEAPS_H
+
+#include <vector>
+#include <utility>
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+
+// Priority queues of (cost, node) pairs for the search kernels. Both return
+// the pair with the smallest cost first.
+
+// Indexed 4-ary min-heap with decrease-key: every node is in the heap at most
+// once, so a search never pops stale entries. Ties are broken by node id.
+class DaryHeap {
+public:
+  using NodeCostPair = std::pair<double, int>;
+
+  explicit DaryHeap(int node_count) : position_(node_count, -1) {}
+
+  bool empty() const { return heap_.empty(); }
+  std::size_t size() const { return heap_.size(); }
+  const NodeCostPair& top() const { return heap_.front(); }
+
+  // Insert a node, or lower its cost if it is already queued with a higher cost
+  void push(double cost, int node) {
+    int pos = position_[node];
+    if (pos < 0) {
+      pos = static_cast<int>(heap_.size());
+      heap_.emplace_back(cost, node);
+      position_[node] = pos;
+      sift_up(pos);
+    } else if (cost < heap_[pos].first) {
+      heap_[pos].first = cost;
+      sift_up(pos);
+    }
+  }
+
+  void pop() {
+    position_[heap_.front().second] = -1;
+    NodeCostPair last = heap_.back();
+    heap_.pop_back();
+    if (!heap_.empty()) {
+      heap_.front() = last;
+      position_[last.second] = 0;
+      sift_down(0);
+    }
+  }
+
+  // Remove all entries; O(size) as only queued nodes are touched
+  void clear() {
+    for (const NodeCostPair& entry : heap_) {
+      position_[entry.second] = -1;
+    }
+    heap_.clear();
+  }
+
+private:
+  static const int ARITY = 4;
+
+  void sift_up(int pos) {
+    NodeCostPair entry = heap_[pos];
+    while (pos > 0) {
+      int parent = (pos - 1) / ARITY;
+      if (!(entry < heap_[parent])) {
+        break;
+      }
+      move(parent, pos);
+      pos = parent;
+    }
+    heap_[pos] = entry;
+    position_[entry.second] = pos;
+  }
+
+  void sift_down(int pos) {
+    NodeCostPair entry = heap_[pos];
+    int size = static_cast<int>(heap_.size());
+    while (true) {
+      int first = pos * ARITY + 1;
+      if (first >= size) {
+        break;
+      }
+      int last = first + ARITY < size ? first + ARITY : size;
+      int best = first;
+      for (int child = first + 1; child < last; ++child) {
+        if (heap_[child] < heap_[best]) {
+          best = child;
+        }
+      }
+      if (!(heap_[best] < entry)) {
+        break;
+      }
+      move(best, pos);
+      pos = best;
+    }
+    heap_[pos] = entry;
+    position_[entry.second] = pos;
+  }
+
+  void move(int from, int to) {
+    heap_[to] = heap_[from];
+    position_[heap_[to].second] = to;
+  }
+
+  std::vector<NodeCostPair> heap_;
+  std::vector<int> position_;
+};
+
+// Radix heap for monotone searches, where no key is smaller than the last
+// extracted one (Dijkstra). The integer keys are the bit patterns of the
+// non-negative costs, which sort like the costs themselves. Improved costs
+// are pushed again; the search skips the stale entries when they are popped.
+class RadixHeap {
+public:
+  using NodeCostPair = std::pair<double, int>;
+
+  RadixHeap() : last_(0), size_(0) {}
+
+  bool empty() const { return size_ == 0; }
+  std::size_t size() const { return size_; }
+
+  const NodeCostPair& top() {
+    if (buckets_[0].empty()) {
+      refill();
+    }
+    return buckets_[0].back().second;
+  }
+
+  // Keys below the last extracted key (only possible through rounding in
+  // the caller) are queued as if they were equal to it
+  void push(double cost, int node) {
+    std::uint64_t key = to_key(cost);
+    if (key < last_) {
+      key = last_;
+    }
+    buckets_[bucket(key)].push_back(std::make_pair(key, NodeCostPair(cost, node)));
+    size_++;
+  }
+
+  void pop() {
+    top();
+    buckets_[0].pop_back();
+    size_--;
+  }
+
+  void clear() {
+    for (std::vector<Entry>& bucket : buckets_) {
+      bucket.clear();
+    }
+    last_ = 0;
+    size_ = 0;
+  }
+
+private:
+  typedef std::pair<std::uint64_t, NodeCostPair> Entry;
+  static const int BUCKET_COUNT = 65;
+
+  static std::uint64_t to_key(double cost) {
+    cost += 0.0; // -0 sorts as 0
+    std::uint64_t key;
+    std::memcpy(&key, &cost, sizeof(key));
+    return key;
+  }
+
+  // Bucket 0 holds keys equal to last_, bucket b keys whose highest bit
+  // differing from last_ is bit b - 1
+  int bucket(std::uint64_t key) const {
+    std::uint64_t diff = key ^ last_;
+    if (diff == 0) {
+      return 0;
+    }
+#if defined(__GNUC__)
+    return 64 - __builtin_clzll(diff);
+#else
+    int b = 0;
+    while (diff != 0) {
+      diff >>= 1;
+      b++;
+    }
+    return b;
+#endif
+  }
+
+  // Move the smallest key of the first non-empty bucket into last_ and
+  // redistribute that bucket, which fills bucket 0
+  void refill() {
+    int b = 1;
+    while (buckets_[b].empty()) {
+      b++;
+    }
+    std::vector<Entry>& source = buckets_[b];
+    std::size_t min = 0;
+    for (std::size_t i = 1; i < source.size(); ++i) {
+      if (source[i] < source[min]) {
+        min = i;
+      }
+    }
+    last_ = source[min].first;
+    for (const Entry& entry : source) {
+      buckets_[bucket(entry.first)].push_back(entry);
+    }
+    source.clear();
+  }
+
+  std::vector<Entry> buckets_[BUCKET_COUNT];
+  std::uint64_t last_;
+  std::size_t size_;
+};
+
+#endif // HEAPS_H
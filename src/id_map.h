@@ -0,0 +1,62 @@
+#ifndef ID_MAP_H
+#define ID_MAP_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Open addressing hash map from 64-bit node keys (pointers, integer ids or
+// the bits of numeric ids) to node ids. It is filled once and can then be
+// queried from several threads at the same time.
+class IdMap {
+public:
+  explicit IdMap(std::size_t count) {
+    std::size_t capacity = 16;
+    while (capacity < 2 * count) {
+      capacity *= 2;
+    }
+    mask_ = capacity - 1;
+    keys_.assign(capacity, 0);
+    ids_.assign(capacity, -1);
+  }
+
+  // Returns false if the key is already present
+  bool insert(std::uint64_t key, int id) {
+    for (std::size_t slot = hash(key) & mask_;; slot = (slot + 1) & mask_) {
+      if (ids_[slot] < 0) {
+        keys_[slot] = key;
+        ids_[slot] = id;
+        return true;
+      }
+      if (keys_[slot] == key) {
+        return false;
+      }
+    }
+  }
+
+  // Returns -1 if the key is not present
+  int find(std::uint64_t key) const {
+    for (std::size_t slot = hash(key) & mask_;; slot = (slot + 1) & mask_) {
+      if (ids_[slot] < 0 || keys_[slot] == key) {
+        return ids_[slot];
+      }
+    }
+  }
+
+private:
+  // splitmix64 finalizer, so pointers and consecutive ids spread over the table
+  static std::size_t hash(std::uint64_t key) {
+    key ^= key >> 30;
+    key *= 0xbf58476d1ce4e5b9ULL;
+    key ^= key >> 27;
+    key *= 0x94d049bb133111ebULL;
+    key ^= key >> 31;
+    return static_cast<std::size_t>(key);
+  }
+
+  std::vector<std::uint64_t> keys_;
+  std::vector<int> ids_;
+  std::size_t mask_;
+};
+
+#endif // ID_MAP_H
@@ -1,123 +1,619 @@
 #include "isochrone.h"
-#include <set>
-#include <queue>
+#include "contraction_hierarchy.h"
+#include "tree_cache.h"
+#include "parallel.h"
+#include <chrono>
 #include <limits>
 #include <functional>
 #include <string>
 #include <sstream>
 #include <algorithm>
-#include <Rcpp.h>
+#include <stdexcept>
+
+// Helper functions
+double assign_thresholds(const double& cost, const std::vector<double>& lim) {
+  double assigned_limit_value = std::numeric_limits<double>::max();
+  
+  for (const auto& threshold : lim) {
+    if (cost <= threshold && threshold < assigned_limit_value) {
+      assigned_limit_value = threshold;
+    }
+  }
+  
+  return assigned_limit_value;
+}
+
+// Append the rows of a start node, count times each; the start row gets the smallest limit
+void append_isochrone_rows(IsochroneColumns& rows, int start, int count, const std::vector<std::pair<double, int>>& reached,
+                           const std::vector<double>& lim) {
+  double min_lim = *std::min_element(lim.begin(), lim.end());
+  std::size_t size = rows.size() + reached.size() * count;
+  rows.start.reserve(size);
+  rows.end.reserve(size);
+  rows.cost.reserve(size);
+  rows.threshold.reserve(size);
+  
+  for (const auto& entry : reached) {
+    double threshold = entry.second == start ? min_lim : assign_thresholds(entry.first, lim);
+    for (int k = 0; k < count; ++k) {
+      rows.start.push_back(start);
+      rows.end.push_back(entry.second);
+      rows.cost.push_back(entry.first);
+      rows.threshold.push_back(threshold);
+    }
+  }
+}
+
+
+// Internal isochrone methods, compiled per cost and counter policy
+template <typename Cost, typename Counters>
+void _calculateIsochrone(const Graph::Adjacency& adjacency, const Cost& cost, int start_node, double max_lim, SearchWorkspace& workspace,
+                         std::vector<std::pair<double, int>>& reached, Counters& counters);
+template <typename Cost>
+void _calculateCatchment(const Graph::Adjacency& adjacency, const Cost& cost, int node_count, const std::vector<int>& start_nodes,
+                         const std::vector<double>& lim, int k, SearchWorkspace& workspace, CatchmentColumns& out);
 
-// [[Rcpp::depends(RcppParallel)]]
-#include <RcppParallel.h>
 
-// RcppParallel worker
-class IsochroneWorker : public RcppParallel::Worker {
+// Parallel worker
+template <typename Cost>
+class IsochroneWorker : public parallel::Worker {
 public:
   IsochroneWorker(const Graph& graph,
+                  int profile,
+                  const Metric& metric,
+                  const Graph::Adjacency& adjacency,
+                  const Cost& cost,
                   const std::vector<int>& start_nodes,
+                  const std::vector<int>& start_counts,
                   const std::vector<double>& lim,
-                  std::vector<std::vector<std::tuple<int, int, double, double>>>& results)
-    : graph_(graph), start_nodes_(start_nodes), lim_(lim), results_(results) {}
+                  std::vector<IsochroneColumns>& chunks,
+                  std::vector<QueryStats>* stats)
+    : graph_(graph), profile_(profile), metric_(metric), adjacency_(adjacency), cost_(cost), start_nodes_(start_nodes),
+      start_counts_(start_counts), lim_(lim), chunks_(chunks), stats_(stats) {}
   
-  // Process start nodes in parallel
+  // Process chunks of start nodes in parallel, reusing one workspace per range
   void operator()(std::size_t begin, std::size_t end) {
-    for (std::size_t i = begin; i < end; ++i) {
-      //NOT Rcpp::checkUserInterrupt();
-      results_[i] = _calculateIsochrone(graph_, {start_nodes_[i]}, lim_);
+    WorkspacePool::Lease workspace(graph_.workspaces());
+    parallel::SlotPool::Lease slot(slots_);
+    std::vector<std::pair<double, int>> reached;
+    double max_lim = *std::max_element(lim_.begin(), lim_.end());
+    NoCounters no_counters;
+    for (std::size_t c = begin; c < end; ++c) {
+      std::size_t first = c * ISOCHRONE_CHUNK_SIZE;
+      std::size_t last = std::min(first + ISOCHRONE_CHUNK_SIZE, start_nodes_.size());
+      for (std::size_t i = first; i < last; ++i) {
+        if (stats_) {
+          // Counted locally and stored once per start node
+          QueryStats stats;
+          QueryCounters counters(stats);
+          std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+          search(start_nodes_[i], max_lim, *workspace, reached, counters);
+          stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+          stats.start = start_nodes_[i];
+          stats.thread = *slot;
+          (*stats_)[i] = stats;
+        } else {
+          search(start_nodes_[i], max_lim, *workspace, reached, no_counters);
+        }
+        append_isochrone_rows(chunks_[c], start_nodes_[i], start_counts_[i], reached, lim_);
+      }
     }
   }
   
 private:
+  // Nodes within max_lim of start_node, from the tree cache of the graph if it is enabled
+  template <typename Counters>
+  void search(int start_node, double max_lim, SearchWorkspace& workspace, std::vector<std::pair<double, int>>& reached,
+              Counters& counters) {
+    TreeCache* cache = graph_.tree_cache();
+    if (!cache) {
+      _calculateIsochrone(adjacency_, cost_, start_node, max_lim, workspace, reached, counters);
+      return;
+    }
+    
+    std::shared_ptr<const SearchTree> tree = cached_search_tree(*cache, TreeCache::Key(profile_, metric_, start_node), adjacency_, cost_,
+                                                                max_lim, nullptr, workspace, counters);
+    std::size_t count = std::upper_bound(tree->cost.begin(), tree->cost.end(), max_lim) - tree->cost.begin();
+    reached.resize(count);
+    for (std::size_t k = 0; k < count; ++k) {
+      reached[k] = std::make_pair(tree->cost[k], tree->node[k]);
+    }
+  }
+  
   const Graph& graph_;
+  int profile_;
+  Metric metric_;
+  const Graph::Adjacency& adjacency_;
+  Cost cost_;
   const std::vector<int>& start_nodes_;
+  const std::vector<int>& start_counts_;
   const std::vector<double>& lim_;
-  std::vector<std::vector<std::tuple<int, int, double, double>>>& results_;
+  std::vector<IsochroneColumns>& chunks_;
+  std::vector<QueryStats>* stats_;
+  parallel::SlotPool slots_;
 };
 
+// Runs the isochrone workers with the cost policy chosen by dispatch_cost
+class IsochroneRun {
+public:
+  IsochroneRun(const Graph& graph,
+               int profile,
+               const Metric& metric,
+               const Graph::Adjacency& adjacency,
+               const std::vector<int>& start_nodes,
+               const std::vector<int>& start_counts,
+               const std::vector<double>& lim,
+               std::vector<IsochroneColumns>& chunks,
+               std::vector<QueryStats>* stats,
+               const parallel::Schedule& schedule)
+    : graph_(graph), profile_(profile), metric_(metric), adjacency_(adjacency), start_nodes_(start_nodes), start_counts_(start_counts), lim_(lim),
+      chunks_(chunks), stats_(stats), schedule_(schedule) {}
+  
+  template <typename Cost>
+  void operator()(const Cost& cost) {
+    IsochroneWorker<Cost> worker(graph_, profile_, metric_, adjacency_, cost, start_nodes_, start_counts_, lim_, chunks_, stats_);
+    parallel::parallelFor(0, chunks_.size(), worker, schedule_);
+  }
+  
+private:
+  const Graph& graph_;
+  int profile_;
+  const Metric& metric_;
+  const Graph::Adjacency& adjacency_;
+  const std::vector<int>& start_nodes_;
+  const std::vector<int>& start_counts_;
+  const std::vector<double>& lim_;
+  std::vector<IsochroneColumns>& chunks_;
+  std::vector<QueryStats>* stats_;
+  const parallel::Schedule& schedule_;
+};
 
-// RcppParallel methods
-std::vector<std::vector<std::tuple<int, int, double, double>>> parallelCalculateIsochrone(
-    const Graph& graph, const std::vector<int>& start_nodes, const std::vector<double>& lim) {
+// Runs the catchment search with the cost policy chosen by dispatch_cost
+class CatchmentRun {
+public:
+  CatchmentRun(const Graph::Adjacency& adjacency,
+               int node_count,
+               const std::vector<int>& start_nodes,
+               const std::vector<double>& lim,
+               int k,
+               SearchWorkspace& workspace,
+               CatchmentColumns& out)
+    : adjacency_(adjacency), node_count_(node_count), start_nodes_(start_nodes), lim_(lim), k_(k), workspace_(workspace), out_(out) {}
   
-  std::size_t num_start_nodes = start_nodes.size();
-  std::vector<std::vector<std::tuple<int, int, double, double>>> results(num_start_nodes);
+  template <typename Cost>
+  void operator()(const Cost& cost) {
+    _calculateCatchment(adjacency_, cost, node_count_, start_nodes_, lim_, k_, workspace_, out_);
+  }
   
-  IsochroneWorker worker(graph, start_nodes, lim, results);
-  RcppParallel::parallelFor(0, num_start_nodes, worker);
+private:
+  const Graph::Adjacency& adjacency_;
+  int node_count_;
+  const std::vector<int>& start_nodes_;
+  const std::vector<double>& lim_;
+  int k_;
+  SearchWorkspace& workspace_;
+  CatchmentColumns& out_;
+};
+
+// Parallel worker for PHAST sweeps, processing chunks in batches of start nodes
+class PhastIsochroneWorker : public parallel::Worker {
+public:
+  PhastIsochroneWorker(const Graph& graph,
+                       const ContractionHierarchy& ch,
+                       const std::vector<int>& start_nodes,
+                       const std::vector<int>& start_counts,
+                       const std::vector<double>& lim,
+                       std::vector<IsochroneColumns>& chunks)
+    : graph_(graph), ch_(ch), start_nodes_(start_nodes), start_counts_(start_counts), lim_(lim), chunks_(chunks) {}
   
-  return results;
-}
+  // Process chunks of start nodes in parallel
+  void operator()(std::size_t begin, std::size_t end) {
+    std::vector<std::vector<std::pair<double, int>>> reached;
+    PhastWorkspace workspace(ch_.node_count());
+    WorkspacePool::Lease upward(graph_.workspaces());
+    double max_lim = *std::max_element(lim_.begin(), lim_.end());
+    for (std::size_t c = begin; c < end; ++c) {
+      std::size_t chunk_last = std::min((c + 1) * ISOCHRONE_CHUNK_SIZE, start_nodes_.size());
+      for (std::size_t first = c * ISOCHRONE_CHUNK_SIZE; first < chunk_last; first += PHAST_BATCH_SIZE) {
+        std::size_t last = std::min(first + PHAST_BATCH_SIZE, chunk_last);
+        std::vector<int> batch(start_nodes_.begin() + first, start_nodes_.begin() + last);
+        
+        _calculateIsochronePhast(ch_, batch, max_lim, workspace, *upward, reached);
+        for (std::size_t k = 0; k < batch.size(); ++k) {
+          append_isochrone_rows(chunks_[c], batch[k], start_counts_[first + k], reached[k], lim_);
+        }
+      }
+    }
+  }
+  
+private:
+  const Graph& graph_;
+  const ContractionHierarchy& ch_;
+  const std::vector<int>& start_nodes_;
+  const std::vector<int>& start_counts_;
+  const std::vector<double>& lim_;
+  std::vector<IsochroneColumns>& chunks_;
+};
 
 
-// Helper function
-double assign_thresholds(const double& cost, const std::vector<double>& lim) {
-  double assigned_limit_value = std::numeric_limits<double>::max();
+// Parallel methods
+std::vector<IsochroneColumns> parallelCalculateIsochrone(
+    const Graph& graph, int profile, const std::vector<int>& start_nodes, const std::vector<double>& lim, const Metric& metric,
+    const std::string& engine, std::vector<QueryStats>* stats, const parallel::Schedule& schedule) {
   
-  for (const auto& threshold : lim) {
-    if (cost <= threshold && threshold < assigned_limit_value) {
-      assigned_limit_value = threshold;
+  // Searches run once per distinct start node, in ascending order
+  std::vector<int> sorted_nodes(start_nodes);
+  std::sort(sorted_nodes.begin(), sorted_nodes.end());
+  std::vector<int> distinct_nodes;
+  std::vector<int> start_counts;
+  for (std::size_t i = 0; i < sorted_nodes.size(); ++i) {
+    if (i == 0 || sorted_nodes[i] != sorted_nodes[i - 1]) {
+      distinct_nodes.push_back(sorted_nodes[i]);
+      start_counts.push_back(0);
     }
+    start_counts.back()++;
   }
   
-  return assigned_limit_value;
+  std::size_t num_chunks = (distinct_nodes.size() + ISOCHRONE_CHUNK_SIZE - 1) / ISOCHRONE_CHUNK_SIZE;
+  std::vector<IsochroneColumns> chunks(num_chunks);
+  parallel::Schedule chunk_schedule = schedule;
+  chunk_schedule.grain = (schedule.grain + ISOCHRONE_CHUNK_SIZE - 1) / ISOCHRONE_CHUNK_SIZE;
+  if (stats) {
+    if (engine != "dijkstra") {
+      throw std::runtime_error("Search statistics are only available for the \"dijkstra\" engine.");
+    }
+    stats->assign(distinct_nodes.size(), QueryStats());
+  }
+  
+  if (engine == "phast") {
+    PhastIsochroneWorker worker(graph, graph.contraction_hierarchy(profile, metric.mode()), distinct_nodes, start_counts, lim, chunks);
+    parallel::parallelFor(0, num_chunks, worker, chunk_schedule);
+  } else if (engine == "dijkstra") {
+    const Graph::Adjacency& adjacency = graph.forward_adjacency(profile);
+    IsochroneRun run(graph, profile, metric, adjacency, distinct_nodes, start_counts, lim, chunks, stats, chunk_schedule);
+    dispatch_cost(adjacency, metric, run);
+  } else {
+    throw std::runtime_error("Invalid isochrone engine.");
+  }
+  
+  return chunks;
 }
 
+
+// Multi-source search entry point: dispatches the metric to the catchment kernel
+void _calculateCatchment(const Graph& graph, int profile, const std::vector<int>& start_nodes, const std::vector<double>& lim,
+                         const Metric& metric, int k, SearchWorkspace& workspace, CatchmentColumns& out) {
+  const Graph::Adjacency& adjacency = graph.forward_adjacency(profile);
+  CatchmentRun run(adjacency, graph.node_count(), start_nodes, lim, k, workspace, out);
+  dispatch_cost(adjacency, metric, run);
+}
+
+
 // Internal isochrone methods
-std::vector<std::tuple<int, int, double, double>> _calculateIsochrone(const Graph& graph, const std::vector<int>& start_nodes, const std::vector<double>& lim) {
+template <typename Cost, typename Counters>
+void _calculateIsochrone(const Graph::Adjacency& adjacency, const Cost& cost, int start_node, double max_lim, SearchWorkspace& workspace,
+                         std::vector<std::pair<double, int>>& reached, Counters& counters) {
   
-  std::vector<std::tuple<int, int, double, double>> result;
-  std::set<std::pair<int, int>> visitedEdges;
+  reached.clear();
+  reached.push_back(std::make_pair(0.0, start_node));
   
-  const std::vector<Graph::Edge>& edges = graph.edges();
-  const std::vector<Graph::Node>& nodes = graph.nodes();
-  int node_count = static_cast<int>(nodes.size());
-  double max_lim = *std::max_element(lim.begin(), lim.end());
+  workspace.reset(workspace.dijkstra_heap());
+  workspace.update(start_node, 0.0);
+  workspace.push(0.0, start_node);
+  counters.push();
   
-  // Create an adjacency list from the edges
-  std::vector<std::vector<Graph::Edge>> adjacencyList(node_count);
-  for (const Graph::Edge& edge : edges) {
-    adjacencyList[edge.from].push_back(edge);
+  while (!workspace.empty()) {
+    double currentCost = workspace.top().first;
+    int currentNode = workspace.top().second;
+    workspace.pop();
+    
+    // Skip stale queue entries; the search ends beyond the largest limit
+    if (currentCost > workspace.cost(currentNode)) {
+      counters.stale();
+      continue;
+    }
+    if (currentCost > max_lim) {
+      break;
+    }
+    counters.settle();
+    
+    // The cost of a node is final once it is settled
+    if (currentNode != start_node) {
+      reached.push_back(std::make_pair(currentCost, currentNode));
+    }
+    
+    for (int e = adjacency.offsets[currentNode]; e < adjacency.offsets[currentNode + 1]; ++e) {
+      int to = adjacency.targets[e];
+      double newCost = currentCost + cost(e);
+      counters.relax();
+      if (newCost < workspace.cost(to)) {
+        workspace.update(to, newCost, currentNode);
+        workspace.push(newCost, to);
+        counters.push();
+      }
+    }
   }
   
-  for (auto start : start_nodes) {
-    result.push_back(std::make_tuple(start, start, 0.0, *std::min_element(lim.begin(), lim.end())));
+  // Nodes are settled in cost order; ties still have to be ordered by node
+  std::sort(reached.begin(), reached.end());
+}
+
+// Multi-source Dijkstra. For k = 1 every node inherits the start node of its
+// parent, so one label per node suffices. For k > 1 a node is settled once per
+// start node, until its k nearest start nodes are known; labels of start nodes
+// that a node does not keep are not expanded further. A node holds at most as
+// many tentative labels as it still keeps, and is queued once, keyed by the
+// smallest of them; labels of equal cost are taken by start node.
+template <typename Cost>
+void _calculateCatchment(const Graph::Adjacency& adjacency, const Cost& cost, int node_count, const std::vector<int>& start_nodes,
+                         const std::vector<double>& lim, int k, SearchWorkspace& workspace, CatchmentColumns& out) {
+  
+  double max_lim = *std::max_element(lim.begin(), lim.end());
+  
+  // Start node and cost of the rank-th label of node v are at v * k + rank
+  std::vector<int> label_start(static_cast<std::size_t>(node_count) * k, -1);
+  std::vector<double> label_cost(static_cast<std::size_t>(node_count) * k);
+  std::vector<int> label_count(node_count, 0);
+  
+  if (k == 1) {
+    workspace.reset();
+    for (int start : start_nodes) {
+      workspace.update(start, 0.0);
+      workspace.push(0.0, start);
+      label_start[start] = start;
+    }
+    
+    while (!workspace.empty()) {
+      double currentCost = workspace.top().first;
+      int currentNode = workspace.top().second;
+      workspace.pop();
+      
+      if (currentCost > workspace.cost(currentNode)) {
+        continue;
+      }
+      if (currentCost > max_lim) {
+        break;
+      }
+      label_cost[currentNode] = currentCost;
+      label_count[currentNode] = 1;
+      
+      for (int e = adjacency.offsets[currentNode]; e < adjacency.offsets[currentNode + 1]; ++e) {
+        int to = adjacency.targets[e];
+        double newCost = currentCost + cost(e);
+        if (newCost < workspace.cost(to)) {
+          workspace.update(to, newCost, currentNode);
+          workspace.push(newCost, to);
+          label_start[to] = label_start[currentNode];
+        }
+      }
+    }
+  } else {
+    // Tentative labels of node v are at v * k .. v * k + k - 1; start node -1
+    // marks a free slot
+    std::vector<int> tentative_start(static_cast<std::size_t>(node_count) * k, -1);
+    std::vector<double> tentative_cost(static_cast<std::size_t>(node_count) * k);
+    auto before = [](double cost1, int start1, double cost2, int start2) {
+      return cost1 < cost2 || (cost1 == cost2 && start1 < start2);
+    };
     
-    std::vector<double> costs(node_count, std::numeric_limits<double>::max());
-    costs[start] = 0.0;
+    // Offers a node the label of a start node, which replaces the node's
+    // tentative label of that start node or its worst one if it is better
+    auto offer = [&](int node, int start, double newCost) {
+      std::size_t first = static_cast<std::size_t>(node) * k;
+      int kept = label_count[node];
+      if (kept == k || std::find(&label_start[first], &label_start[first] + kept, start) != &label_start[first] + kept) {
+        return;
+      }
+      
+      int slot = -1;
+      int free_slot = -1;
+      int worst = -1;
+      int used = 0;
+      for (int s = 0; s < k && slot < 0; ++s) {
+        std::size_t i = first + s;
+        if (tentative_start[i] == start) {
+          slot = s;
+        } else if (tentative_start[i] < 0) {
+          free_slot = s;
+        } else {
+          used++;
+          if (worst < 0 || before(tentative_cost[first + worst], tentative_start[first + worst], tentative_cost[i], tentative_start[i])) {
+            worst = s;
+          }
+        }
+      }
+      if (slot >= 0) {
+        if (newCost >= tentative_cost[first + slot]) {
+          return;
+        }
+      } else if (used < k - kept) {
+        slot = free_slot;
+      } else if (before(newCost, start, tentative_cost[first + worst], tentative_start[first + worst])) {
+        slot = worst;
+      } else {
+        return;
+      }
+      tentative_start[first + slot] = start;
+      tentative_cost[first + slot] = newCost;
+      
+      if (newCost < workspace.cost(node)) {
+        workspace.update(node, newCost);
+        workspace.push(newCost, node);
+      }
+    };
     
-    using NodeCostPair = std::pair<double, int>;
-    std::priority_queue<NodeCostPair, std::vector<NodeCostPair>, std::greater<NodeCostPair>> pq;
-    pq.push({0.0, start});
+    workspace.reset();
+    for (int start : start_nodes) {
+      offer(start, start, 0.0);
+    }
     
-    while (!pq.empty()) {
-      double currentCost = pq.top().first;
-      int currentNode = pq.top().second;
-      pq.pop();
+    while (!workspace.empty()) {
+      double currentCost = workspace.top().first;
+      int currentNode = workspace.top().second;
+      workspace.pop();
       
       if (currentCost > max_lim) {
-        continue;
+        break;
       }
       
-      for (const Graph::Edge& edge : adjacencyList[currentNode]) {
-        double newCost = currentCost + edge.cost;
-        if (newCost < costs[edge.to]) {
-          costs[edge.to] = newCost;
-          
-          if (visitedEdges.find({start, edge.to}) == visitedEdges.end()) {
-            visitedEdges.insert({start, edge.to});
-            
-            if (start != edge.to && newCost <= max_lim) {
-              double threshold = assign_thresholds(newCost, lim);
-              result.push_back(std::make_tuple(start, edge.to, newCost, threshold));
-            }
-          }
-          
-          pq.push({newCost, edge.to});
+      // Keep the smallest tentative label and queue the node for the next one
+      std::size_t first = static_cast<std::size_t>(currentNode) * k;
+      int best = -1;
+      for (int s = 0; s < k; ++s) {
+        std::size_t i = first + s;
+        if (tentative_start[i] >= 0 && (best < 0 || before(tentative_cost[i], tentative_start[i], tentative_cost[first + best], tentative_start[first + best]))) {
+          best = s;
         }
       }
+      int start = tentative_start[first + best];
+      tentative_start[first + best] = -1;
+      int count = label_count[currentNode];
+      label_start[first + count] = start;
+      label_cost[first + count] = currentCost;
+      label_count[currentNode] = count + 1;
+      
+      double next = std::numeric_limits<double>::max();
+      for (int s = 0; s < k; ++s) {
+        if (tentative_start[first + s] >= 0) {
+          next = std::min(next, tentative_cost[first + s]);
+        }
+      }
+      workspace.update(currentNode, next);
+      if (next < std::numeric_limits<double>::max()) {
+        workspace.push(next, currentNode);
+      }
+      
+      for (int e = adjacency.offsets[currentNode]; e < adjacency.offsets[currentNode + 1]; ++e) {
+        int to = adjacency.targets[e];
+        if (label_count[to] < k) {
+          offer(to, start, currentCost + cost(e));
+        }
+      }
+    }
+  }
+  
+  for (int node = 0; node < node_count; ++node) {
+    for (int rank = 0; rank < label_count[node]; ++rank) {
+      std::size_t label = static_cast<std::size_t>(node) * k + rank;
+      out.start.push_back(label_start[label]);
+      out.end.push_back(node);
+      out.rank.push_back(rank + 1);
+      out.cost.push_back(label_cost[label]);
+      out.threshold.push_back(assign_thresholds(label_cost[label], lim));
     }
   }
+}
+
+PhastWorkspace::PhastWorkspace(int node_count)
+  : costs(static_cast<std::size_t>(node_count) * PHAST_BATCH_SIZE, std::numeric_limits<double>::infinity()),
+    bound(node_count, std::numeric_limits<double>::infinity()),
+    active(node_count, 0) {}
+
+// RPHAST: one pruned upward search per start node, followed by a linear sweep
+// in descending rank order over the nodes reachable downwards from the upward
+// search spaces within max_lim. Up to PHAST_BATCH_SIZE start nodes share one
+// sweep, with their distances interleaved per node.
+void _calculateIsochronePhast(const ContractionHierarchy& ch, const std::vector<int>& start_nodes, double max_lim,
+                              PhastWorkspace& workspace, SearchWorkspace& upward,
+                              std::vector<std::vector<std::pair<double, int>>>& reached) {
+  
+  const ContractionHierarchy::SweepGraph& sweep = ch.sweep_graph();
+  const std::size_t K = PHAST_BATCH_SIZE;
+  const double inf = std::numeric_limits<double>::infinity();
+  
+  // Distance of lane k at sweep position p is costs[p * K + k]; bound[p] is
+  // the smallest distance of any lane
+  std::vector<double>& costs = workspace.costs;
+  std::vector<double>& bound = workspace.bound;
+  std::vector<char>& active = workspace.active;
+  std::vector<int>& queue = workspace.queue;
+  std::vector<int>& selected = workspace.selected;
+  std::greater<int> later;
+  queue.clear();
+  selected.clear();
   
-  return result;
-}
\ No newline at end of file
+  for (std::size_t k = 0; k < start_nodes.size(); ++k) {
+    for (const auto& entry : ch.upward_search(start_nodes[k], true, upward, max_lim)) {
+      int pos = sweep.position[entry.first];
+      costs[pos * K + k] = entry.second;
+      if (bound[pos] == inf) {
+        queue.push_back(pos);
+        std::push_heap(queue.begin(), queue.end(), later);
+      }
+      bound[pos] = std::min(bound[pos], entry.second);
+    }
+  }
+  
+  // Select the restricted subgraph: positions are taken in ascending order, so
+  // the bound of a position is final once it is taken, and only positions
+  // within max_lim of some lane enter the queue
+  while (!queue.empty()) {
+    std::pop_heap(queue.begin(), queue.end(), later);
+    int pos = queue.back();
+    queue.pop_back();
+    selected.push_back(pos);
+    for (int a = sweep.down_offsets[pos]; a < sweep.down_offsets[pos + 1]; ++a) {
+      int target_pos = sweep.down_targets[a];
+      double new_bound = bound[pos] + sweep.weights[sweep.down_arcs[a]];
+      if (new_bound > max_lim || new_bound >= bound[target_pos]) {
+        continue;
+      }
+      if (bound[target_pos] == inf) {
+        queue.push_back(target_pos);
+        std::push_heap(queue.begin(), queue.end(), later);
+      }
+      bound[target_pos] = new_bound;
+    }
+  }
+  
+  // Sweep the selected positions; positions outside it keep infinite costs
+  for (int pos : selected) {
+    double* target = &costs[pos * K];
+    for (int a = sweep.offsets[pos]; a < sweep.offsets[pos + 1]; ++a) {
+      int source_pos = sweep.sources[a];
+      if (!active[source_pos]) {
+        continue;
+      }
+      const double* source = &costs[source_pos * K];
+      double weight = sweep.weights[a];
+      for (std::size_t k = 0; k < K; ++k) {
+        target[k] = std::min(target[k], source[k] + weight);
+      }
+    }
+    
+    char reached_any = 0;
+    for (std::size_t k = 0; k < K; ++k) {
+      if (target[k] > max_lim) {
+        target[k] = inf;
+      } else {
+        reached_any = 1;
+      }
+    }
+    active[pos] = reached_any;
+  }
+  
+  reached.resize(start_nodes.size());
+  for (std::size_t k = 0; k < start_nodes.size(); ++k) {
+    int start = start_nodes[k];
+    std::vector<std::pair<double, int>>& result = reached[k];
+    result.clear();
+    result.push_back(std::make_pair(0.0, start));
+    
+    for (int pos : selected) {
+      double cost = costs[pos * K + k];
+      int node = sweep.order[pos];
+      if (cost <= max_lim && node != start) {
+        result.push_back(std::make_pair(cost, node));
+      }
+    }
+    
+    std::sort(result.begin(), result.end());
+  }
+  
+  // Leave the workspace clean for the next batch
+  for (int pos : selected) {
+    std::fill(costs.begin() + pos * K, costs.begin() + (pos + 1) * K, inf);
+    bound[pos] = inf;
+    active[pos] = 0;
+  }
+}
@@ -2,14 +2,84 @@
 #define ISOCHRONE_H
 
 #include "graph.h"
+#include "search_workspace.h"
+#include "search_policies.h"
+#include "parallel.h"
 #include <vector>
-#include <tuple>
+#include <utility>
+#include <string>
+#include <cstddef>
 
-// RcppParallel methods
-std::vector<std::vector<std::tuple<int, int, double, double>>> parallelCalculateIsochrone(
-    const Graph& graph, const std::vector<int>& start_nodes, const std::vector<double>& lim);
+class ContractionHierarchy;
+
+// Number of start nodes that share one PHAST sweep
+const std::size_t PHAST_BATCH_SIZE = 8;
+
+// Number of distinct start nodes per chunk of isochrone results (a multiple of PHAST_BATCH_SIZE)
+const std::size_t ISOCHRONE_CHUNK_SIZE = 64;
+
+// Isochrone rows of a chunk of start nodes in column layout
+struct IsochroneColumns {
+  std::vector<int> start;
+  std::vector<int> end;
+  std::vector<double> cost;
+  std::vector<double> threshold;
+  
+  std::size_t size() const { return start.size(); }
+};
+
+// Scratch space of PHAST sweeps, allocated once per worker chunk and reused by
+// its batches. Between sweeps, the lane costs and bounds of every position are
+// infinite; a sweep only resets the positions it selected.
+struct PhastWorkspace {
+  std::vector<double> costs;
+  std::vector<double> bound;
+  std::vector<char> active;
+  std::vector<int> queue;
+  std::vector<int> selected;
+  
+  explicit PhastWorkspace(int node_count);
+};
+
+// Nearest start nodes of the nodes reached by a multi-source search, in column
+// layout: start is the rank-th nearest start node of end. Rows are ordered by
+// end node and rank.
+struct CatchmentColumns {
+  std::vector<int> start;
+  std::vector<int> end;
+  std::vector<int> rank;
+  std::vector<double> cost;
+  std::vector<double> threshold;
+  
+  std::size_t size() const { return start.size(); }
+};
+
+// Parallel methods
+// Rows of all start nodes, ordered by start node, cost and end node. Every
+// chunk holds the rows of up to ISOCHRONE_CHUNK_SIZE consecutive distinct
+// start nodes; the rows of a start node given k times are repeated k times.
+// If stats is given, the Dijkstra engine counts the work of every distinct
+// start node into it, in ascending order of start node. With the tree cache
+// of the graph enabled, the Dijkstra engine reads and grows cached search
+// trees, and only the growing counts as work. Chunks are scheduled
+// at the grain of schedule, rounded up to whole chunks; its monitor may
+// cancel the run.
+std::vector<IsochroneColumns> parallelCalculateIsochrone(
+    const Graph& graph, int profile, const std::vector<int>& start_nodes, const std::vector<double>& lim, const Metric& metric,
+    const std::string& engine = "dijkstra", std::vector<QueryStats>* stats = nullptr,
+    const parallel::Schedule& schedule = parallel::Schedule());
+
+// Multi-source search: one search seeded with all start nodes at cost 0 that
+// finds the k nearest distinct start nodes of every node within max(lim)
+void _calculateCatchment(const Graph& graph, int profile, const std::vector<int>& start_nodes, const std::vector<double>& lim,
+                         const Metric& metric, int k, SearchWorkspace& workspace, CatchmentColumns& out);
 
 // Internal methods
-std::vector<std::tuple<int, int, double, double>> _calculateIsochrone(const Graph& graph, const std::vector<int>& start_nodes, const std::vector<double>& lim);
+// Nodes reached within max_lim as (cost, node) pairs, ordered by cost and node;
+// the start node is always included. The Dijkstra kernel is a template over
+// the cost policy and is defined in isochrone.cpp.
+void _calculateIsochronePhast(const ContractionHierarchy& ch, const std::vector<int>& start_nodes, double max_lim,
+                              PhastWorkspace& workspace, SearchWorkspace& upward,
+                              std::vector<std::vector<std::pair<double, int>>>& reached);
 
-#endif // ISOCHRONE_H
\ No newline at end of file
+#endif // ISOCHRONE_H
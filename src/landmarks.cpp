@@ -0,0 +1,108 @@
+#include "landmarks.h"
+#include <queue>
+#include <limits>
+#include <algorithm>
+#include <functional>
+
+namespace {
+
+// Costs from source to all nodes (or from all nodes to source on the reverse adjacency)
+std::vector<double> one_to_all(const Graph::Adjacency& adjacency, const Buffer<Graph::Weight>& weights,
+                               int node_count, int source) {
+  std::vector<double> costs(node_count, std::numeric_limits<double>::infinity());
+  costs[source] = 0.0;
+
+  using NodeCostPair = std::pair<double, int>;
+  std::priority_queue<NodeCostPair, std::vector<NodeCostPair>, std::greater<NodeCostPair>> pq;
+  pq.push({0.0, source});
+
+  while (!pq.empty()) {
+    double current_cost = pq.top().first;
+    int current_node = pq.top().second;
+    pq.pop();
+
+    if (current_cost > costs[current_node]) {
+      continue;
+    }
+
+    for (int e = adjacency.offsets[current_node]; e < adjacency.offsets[current_node + 1]; ++e) {
+      int to = adjacency.targets[e];
+      double new_cost = current_cost + weights[e];
+      if (new_cost < costs[to]) {
+        costs[to] = new_cost;
+        pq.push({new_cost, to});
+      }
+    }
+  }
+
+  return costs;
+}
+
+}
+
+
+// Constructor: farthest landmark selection. Each new landmark is the node
+// that is farthest from all landmarks chosen so far; unreachable nodes count
+// as farthest, so every weakly connected part of the graph gets covered.
+Landmarks::Landmarks(const Graph& graph, int profile, const std::string& mode, int count) {
+  const Graph::Adjacency& forward = graph.forward_adjacency(profile);
+  const Graph::Adjacency& reverse = graph.reverse_adjacency(profile);
+  const Buffer<Graph::Weight>& forward_weights = mode == "time" ? forward.cost : forward.length;
+  const Buffer<Graph::Weight>& reverse_weights = mode == "time" ? reverse.cost : reverse.length;
+  int node_count = graph.node_count();
+
+  count_ = std::max(0, std::min(count, node_count));
+  from_landmark_.assign(static_cast<size_t>(node_count) * count_, std::numeric_limits<double>::infinity());
+  to_landmark_.assign(static_cast<size_t>(node_count) * count_, std::numeric_limits<double>::infinity());
+
+  // Start from the node farthest away from node 0
+  std::vector<double> separation = node_count > 0 ? one_to_all(forward, forward_weights, node_count, 0)
+                                                  : std::vector<double>();
+
+  for (int l = 0; l < count_; ++l) {
+    int landmark = static_cast<int>(std::max_element(separation.begin(), separation.end()) - separation.begin());
+    nodes_.push_back(landmark);
+
+    std::vector<double> from_costs = one_to_all(forward, forward_weights, node_count, landmark);
+    std::vector<double> to_costs = one_to_all(reverse, reverse_weights, node_count, landmark);
+    for (int v = 0; v < node_count; ++v) {
+      from_landmark_[static_cast<size_t>(v) * count_ + l] = from_costs[v];
+      to_landmark_[static_cast<size_t>(v) * count_ + l] = to_costs[v];
+
+      double landmark_separation = std::min(from_costs[v], to_costs[v]);
+      separation[v] = (l == 0) ? landmark_separation : std::min(separation[v], landmark_separation);
+    }
+  }
+}
+
+
+// Getters
+int Landmarks::count() const {
+  return count_;
+}
+
+const std::vector<int>& Landmarks::nodes() const {
+  return nodes_;
+}
+
+
+// Triangle inequality: d(L, t) - d(L, v) <= d(v, t) and d(v, L) - d(t, L) <= d(v, t)
+double Landmarks::lower_bound(int node, int target) const {
+  const double* from_node = &from_landmark_[static_cast<size_t>(node) * count_];
+  const double* from_target = &from_landmark_[static_cast<size_t>(target) * count_];
+  const double* to_node = &to_landmark_[static_cast<size_t>(node) * count_];
+  const double* to_target = &to_landmark_[static_cast<size_t>(target) * count_];
+  const double inf = std::numeric_limits<double>::infinity();
+
+  double bound = 0.0;
+  for (int l = 0; l < count_; ++l) {
+    if (from_node[l] < inf && from_target[l] < inf) {
+      bound = std::max(bound, from_target[l] - from_node[l]);
+    }
+    if (to_node[l] < inf && to_target[l] < inf) {
+      bound = std::max(bound, to_node[l] - to_target[l]);
+    }
+  }
+
+  return bound;
+}
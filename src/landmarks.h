@@ -0,0 +1,32 @@
+#ifndef LANDMARKS_H
+#define LANDMARKS_H
+
+#include "graph.h"
+#include <vector>
+#include <string>
+
+// Default number of landmarks selected per routing profile and mode
+const int DEFAULT_LANDMARK_COUNT = 8;
+
+class Landmarks {
+public:
+  // Constructor: selects landmarks on a routing profile of the graph for the given mode ("time" or "distance")
+  Landmarks(const Graph& graph, int profile, const std::string& mode, int count);
+
+  // Getters
+  int count() const;
+  const std::vector<int>& nodes() const;
+
+  // Lower bound of the cost from node to target (ALT heuristic)
+  double lower_bound(int node, int target) const;
+
+private:
+  // Member variables
+  int count_;
+  std::vector<int> nodes_;
+  // Costs from and to every landmark, stored per node: [node * count_ + landmark]
+  std::vector<double> from_landmark_;
+  std::vector<double> to_landmark_;
+};
+
+#endif // LANDMARKS_H
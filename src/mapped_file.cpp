@@ -0,0 +1,80 @@
+#include "mapped_file.h"
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// Constructor
+MappedFile::MappedFile(const std::string& path) : data_(nullptr), size_(0) {
+#ifdef _WIN32
+  HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file == INVALID_HANDLE_VALUE) {
+    throw std::runtime_error("Cannot open graph file: " + path);
+  }
+  LARGE_INTEGER file_size;
+  if (!GetFileSizeEx(file, &file_size)) {
+    CloseHandle(file);
+    throw std::runtime_error("Cannot read graph file: " + path);
+  }
+  size_ = static_cast<std::size_t>(file_size.QuadPart);
+  if (size_ > 0) {
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping != NULL) {
+      data_ = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+      CloseHandle(mapping); // The view keeps the mapping alive
+    }
+  }
+  CloseHandle(file);
+#else
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("Cannot open graph file: " + path);
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0) {
+    close(fd);
+    throw std::runtime_error("Cannot read graph file: " + path);
+  }
+  size_ = static_cast<std::size_t>(file_stat.st_size);
+  if (size_ > 0) {
+    void* address = mmap(NULL, size_, PROT_READ, MAP_SHARED, fd, 0);
+    if (address != MAP_FAILED) {
+      data_ = static_cast<const char*>(address);
+    }
+  }
+  close(fd); // The mapping stays valid after the descriptor is closed
+#endif
+
+  if (size_ > 0 && data_ == nullptr) {
+    throw std::runtime_error("Cannot map graph file: " + path);
+  }
+}
+
+MappedFile::~MappedFile() {
+  if (data_ == nullptr) {
+    return;
+  }
+#ifdef _WIN32
+  UnmapViewOfFile(data_);
+#else
+  munmap(const_cast<char*>(data_), size_);
+#endif
+}
+
+
+// Getters
+const char* MappedFile::data() const {
+  return data_;
+}
+
+std::size_t MappedFile::size() const {
+  return size_;
+}
@@ -0,0 +1,27 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <string>
+#include <cstddef>
+
+// Read-only memory mapping of a whole file. Processes that map the same
+// file share its pages through the operating system's page cache.
+class MappedFile {
+public:
+  explicit MappedFile(const std::string& path);
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  // Getters
+  const char* data() const;
+  std::size_t size() const;
+
+private:
+  // Member variables
+  const char* data_;
+  std::size_t size_;
+};
+
+#endif // MAPPED_FILE_H
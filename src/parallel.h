@@ -0,0 +1,275 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+// Parallel loops of the routing core. In the R package they run on
+// RcppParallel; the standalone core library (built with GEOROUTER_STANDALONE,
+// see CMakeLists.txt) has no R dependency and runs them on std::thread.
+#ifndef GEOROUTER_STANDALONE
+
+// [[Rcpp::depends(RcppParallel)]]
+#include <RcppParallel.h>
+
+namespace parallel {
+
+typedef RcppParallel::Worker Worker;
+using RcppParallel::parallelFor;
+
+}
+
+#else
+
+#include <cstddef>
+#include <cstdlib>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <mutex>
+#include <exception>
+#include <algorithm>
+
+namespace parallel {
+
+// Body of a parallel loop: processes the indices begin .. end - 1
+class Worker {
+public:
+  virtual ~Worker() {}
+  virtual void operator()(std::size_t begin, std::size_t end) = 0;
+};
+
+// Number of threads: GEOROUTER_NUM_THREADS if set, else all hardware threads
+inline int default_thread_count() {
+  const char* value = std::getenv("GEOROUTER_NUM_THREADS");
+  int threads = value ? std::atoi(value) : 0;
+  if (threads <= 0) {
+    threads = static_cast<int>(std::thread::hardware_concurrency());
+  }
+  return std::max(threads, 1);
+}
+
+// Runs worker over [begin, end) with guided self-scheduling: idle threads take
+// the next chunk of the remaining indices, sized remaining / (2 * threads) but
+// at least grain, so chunks shrink towards the end and slow indices at the
+// tail do not leave the other threads idle. The first exception of a worker
+// is rethrown.
+inline void parallelFor(std::size_t begin, std::size_t end, Worker& worker, std::size_t grain = 1, int threads = -1) {
+  if (begin >= end) {
+    return;
+  }
+  if (threads <= 0) {
+    threads = default_thread_count();
+  }
+  grain = std::max<std::size_t>(grain, 1);
+  std::size_t size = end - begin;
+  if (threads == 1 || size <= grain) {
+    worker(begin, end);
+    return;
+  }
+
+  std::atomic<std::size_t> next(begin);
+  std::exception_ptr error;
+  std::mutex error_mutex;
+  auto run = [&]() {
+    std::size_t first = next.load();
+    while (first < end) {
+      std::size_t chunk = std::max(grain, (end - first) / (2 * threads));
+      std::size_t last = std::min(end, first + chunk);
+      if (!next.compare_exchange_weak(first, last)) {
+        continue;
+      }
+      try {
+        worker(first, last);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(error_mutex);
+        if (!error) {
+          error = std::current_exception();
+        }
+        next = end;
+      }
+      first = next.load();
+    }
+  };
+
+  std::vector<std::thread> pool;
+  int count = static_cast<int>(std::min<std::size_t>(threads, (size + grain - 1) / grain));
+  for (int t = 1; t < count; ++t) {
+    pool.emplace_back(run);
+  }
+  run();
+  for (std::thread& thread : pool) {
+    thread.join();
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+}
+
+#endif // GEOROUTER_STANDALONE
+
+#include <cstddef>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <exception>
+#include <stdexcept>
+#include <algorithm>
+#include <vector>
+
+namespace parallel {
+
+// Observer of a long parallel loop. It is polled on the calling thread while
+// the workers run, so it may call into R; the workers never do.
+class Monitor {
+public:
+  virtual ~Monitor() {}
+
+  // Called every POLL_INTERVAL and once at the end with the number of
+  // finished indices; returns false to cancel the loop
+  virtual bool poll(std::size_t done, std::size_t total) = 0;
+
+  static const int POLL_INTERVAL_MS = 100;
+};
+
+// Thrown by parallelFor when its monitor cancels the loop
+class Cancelled : public std::runtime_error {
+public:
+  Cancelled() : std::runtime_error("The computation was interrupted.") {}
+};
+
+// Scheduling of the parallel loop over the start nodes of a query: the
+// minimum number of indices per task and an optional monitor
+struct Schedule {
+  std::size_t grain;
+  Monitor* monitor;
+
+  Schedule() : grain(1), monitor(nullptr) {}
+};
+
+// Worker running another worker in steps of grain indices, counting the
+// finished ones and stopping at the next step once the loop is cancelled
+class SteppedWorker : public Worker {
+public:
+  SteppedWorker(Worker& worker, std::size_t grain, std::atomic<std::size_t>& done, const std::atomic<bool>& cancelled)
+    : worker_(worker), grain_(grain), done_(done), cancelled_(cancelled) {}
+
+  void operator()(std::size_t begin, std::size_t end) {
+    for (std::size_t first = begin; first < end && !cancelled_.load(std::memory_order_relaxed); first += grain_) {
+      std::size_t last = std::min(end, first + grain_);
+      worker_(first, last);
+      done_.fetch_add(last - first, std::memory_order_relaxed);
+    }
+  }
+
+private:
+  Worker& worker_;
+  std::size_t grain_;
+  std::atomic<std::size_t>& done_;
+  const std::atomic<bool>& cancelled_;
+};
+
+// Runs worker over [begin, end) at the grain of a schedule. With a monitor,
+// the loop runs on a separate thread while this thread polls the monitor;
+// Cancelled is thrown if the monitor cancels the loop.
+inline void parallelFor(std::size_t begin, std::size_t end, Worker& worker, const Schedule& schedule) {
+  std::size_t grain = std::max<std::size_t>(schedule.grain, 1);
+  if (!schedule.monitor || begin >= end) {
+    parallelFor(begin, end, worker, grain);
+    return;
+  }
+
+  std::atomic<std::size_t> done(0);
+  std::atomic<bool> cancelled(false);
+  SteppedWorker stepped(worker, grain, done, cancelled);
+
+  bool finished = false;
+  std::mutex mutex;
+  std::condition_variable finished_changed;
+  std::exception_ptr error;
+  std::thread loop([&]() {
+    try {
+      parallelFor(begin, end, stepped, grain);
+    } catch (...) {
+      error = std::current_exception();
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    finished = true;
+    finished_changed.notify_one();
+  });
+
+  std::size_t total = end - begin;
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!finished_changed.wait_for(lock, std::chrono::milliseconds(Monitor::POLL_INTERVAL_MS), [&]() { return finished; })) {
+      lock.unlock();
+      if (!cancelled && !schedule.monitor->poll(done.load(), total)) {
+        cancelled = true;
+      }
+      lock.lock();
+    }
+  }
+  loop.join();
+
+  if (error) {
+    std::rethrow_exception(error);
+  }
+  if (cancelled || !schedule.monitor->poll(done.load(), total)) {
+    throw Cancelled();
+  }
+}
+
+// Small indices of the threads of one parallel loop. A worker leases a slot
+// per chunk and returns it when the chunk is done; the lowest free slot is
+// handed out first, so slots stay below the number of chunks running at
+// once, i.e. below the thread count of the loop, however many threads the
+// backend starts over a session.
+class SlotPool {
+public:
+  SlotPool() : count_(0) {}
+
+  SlotPool(const SlotPool&) = delete;
+  SlotPool& operator=(const SlotPool&) = delete;
+
+  // Slot that is returned to the pool when the lease goes out of scope
+  class Lease {
+  public:
+    explicit Lease(SlotPool& pool) : pool_(pool), slot_(pool.acquire()) {}
+    ~Lease() { pool_.release(slot_); }
+
+    Lease(const Lease&) = delete;
+    Lease& operator=(const Lease&) = delete;
+
+    int operator*() const { return slot_; }
+
+  private:
+    SlotPool& pool_;
+    int slot_;
+  };
+
+private:
+  int acquire() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (free_.empty()) {
+      return count_++;
+    }
+    std::vector<int>::iterator lowest = std::min_element(free_.begin(), free_.end());
+    int slot = *lowest;
+    free_.erase(lowest);
+    return slot;
+  }
+
+  void release(int slot) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    free_.push_back(slot);
+  }
+
+  std::mutex mutex_;
+  std::vector<int> free_;
+  int count_;
+};
+
+}
+
+#endif // PARALLEL_H
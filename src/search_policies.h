@@ -0,0 +1,206 @@
+#ifndef SEARCH_POLICIES_H
+#define SEARCH_POLICIES_H
+
+#include "graph.h"
+#include "landmarks.h"
+#include <string>
+#include <cstdint>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <stdexcept>
+
+// Metric of a search: the weight of an arc is time * cost + distance * length.
+// "time" and "distance" are the pure metrics; any other mix is weighted.
+struct Metric {
+  enum Type {
+    TIME,
+    DISTANCE,
+    WEIGHTED
+  };
+  
+  Type type;
+  double time;
+  double distance;
+  
+  // Metric of a mode ("time" or "distance")
+  explicit Metric(const std::string& mode) {
+    if (mode == "time") {
+      *this = Metric(1.0, 0.0);
+    } else if (mode == "distance") {
+      *this = Metric(0.0, 1.0);
+    } else {
+      throw std::runtime_error("Invalid mode: " + mode);
+    }
+  }
+  
+  Metric(double time_weight, double distance_weight) : time(time_weight), distance(distance_weight) {
+    if (!(time >= 0 && distance >= 0) || time + distance == 0) {
+      throw std::runtime_error("Metric weights must be non-negative and not both zero.");
+    }
+    type = distance == 0 && time == 1 ? TIME : (time == 0 && distance == 1 ? DISTANCE : WEIGHTED);
+  }
+  
+  // Mode of a pure metric, under which contraction hierarchies and landmarks are prepared
+  std::string mode() const {
+    if (type == WEIGHTED) {
+      throw std::runtime_error("This engine supports only the \"time\" and \"distance\" modes.");
+    }
+    return type == TIME ? "time" : "distance";
+  }
+};
+
+
+// Cost policies: the weight of arc e of an adjacency under a metric. The
+// search kernels are templates over these, so their inner loops compile to a
+// plain array load (or a multiply-add for weighted metrics).
+class TimeCost {
+public:
+  TimeCost(const Graph::Adjacency& adjacency, const Metric&) : cost_(adjacency.cost.data()) {}
+  double operator()(int e) const { return cost_[e]; }
+  
+private:
+  const Graph::Weight* cost_;
+};
+
+class DistanceCost {
+public:
+  DistanceCost(const Graph::Adjacency& adjacency, const Metric&) : length_(adjacency.length.data()) {}
+  double operator()(int e) const { return length_[e]; }
+  
+private:
+  const Graph::Weight* length_;
+};
+
+class WeightedCost {
+public:
+  WeightedCost(const Graph::Adjacency& adjacency, const Metric& metric)
+    : cost_(adjacency.cost.data()), length_(adjacency.length.data()), time_(metric.time), distance_(metric.distance) {}
+  double operator()(int e) const { return time_ * cost_[e] + distance_ * length_[e]; }
+  
+private:
+  const Graph::Weight* cost_;
+  const Graph::Weight* length_;
+  double time_;
+  double distance_;
+};
+
+
+// Heuristic policies: a consistent lower bound of the cost from a node to the
+// current target of an A* search
+class NoHeuristic {
+public:
+  void set_target(int) {}
+  double operator()(int) const { return 0.0; }
+};
+
+// Straight-line distance to the target, scaled by the smallest ratio of arc
+// weight to arc length in the plane. This keeps the bound consistent for any
+// metric and any coordinate reference system.
+class EuclideanHeuristic {
+public:
+  template <typename Cost>
+  EuclideanHeuristic(const Graph& graph, const Graph::Adjacency& adjacency, const Cost& cost)
+    : graph_(graph), scale_(std::numeric_limits<double>::infinity()), target_x_(0.0), target_y_(0.0) {
+    for (int u = 0; u < graph.node_count(); ++u) {
+      for (int e = adjacency.offsets[u]; e < adjacency.offsets[u + 1]; ++e) {
+        double d = std::hypot(graph.node_x(adjacency.targets[e]) - graph.node_x(u),
+                              graph.node_y(adjacency.targets[e]) - graph.node_y(u));
+        if (d > 0) {
+          scale_ = std::min(scale_, cost(e) / d);
+        }
+      }
+    }
+    if (!(scale_ < std::numeric_limits<double>::infinity())) {
+      scale_ = 0.0;
+    }
+  }
+  
+  void set_target(int target) {
+    target_x_ = graph_.node_x(target);
+    target_y_ = graph_.node_y(target);
+  }
+  double operator()(int node) const {
+    return scale_ * std::hypot(graph_.node_x(node) - target_x_, graph_.node_y(node) - target_y_);
+  }
+  
+private:
+  const Graph& graph_;
+  double scale_;
+  double target_x_;
+  double target_y_;
+};
+
+// Landmark (ALT) lower bounds
+class LandmarkHeuristic {
+public:
+  explicit LandmarkHeuristic(const Landmarks& landmarks) : landmarks_(landmarks), target_(0) {}
+  
+  void set_target(int target) { target_ = target; }
+  double operator()(int node) const { return landmarks_.lower_bound(node, target_); }
+  
+private:
+  const Landmarks& landmarks_;
+  int target_;
+};
+
+
+// Work of the search of one start node: settled nodes, relaxed arcs, queue
+// pushes and stale queue entries popped, with its wall time and the index of
+// the thread that ran it
+struct QueryStats {
+  int start;
+  std::uint64_t settled;
+  std::uint64_t relaxed;
+  std::uint64_t pushes;
+  std::uint64_t stale;
+  double seconds;
+  int thread;
+  
+  QueryStats() : start(-1), settled(0), relaxed(0), pushes(0), stale(0), seconds(0.0), thread(-1) {}
+};
+
+// Counter policies of the search kernels. NoCounters compiles to nothing, so
+// searches without statistics run the same code as before; QueryCounters adds
+// to the QueryStats of the current start node, which only its worker writes.
+class NoCounters {
+public:
+  void settle() {}
+  void relax() {}
+  void push() {}
+  void stale() {}
+};
+
+class QueryCounters {
+public:
+  explicit QueryCounters(QueryStats& stats) : stats_(stats) {}
+  
+  void settle() { stats_.settled++; }
+  void relax() { stats_.relaxed++; }
+  void push() { stats_.pushes++; }
+  void stale() { stats_.stale++; }
+  
+private:
+  QueryStats& stats_;
+};
+
+
+// Run run(cost) with the cost policy of a metric on an adjacency. Run is a
+// functor with a template call operator, so the metric is dispatched once and
+// everything below it is compiled per policy.
+template <typename Run>
+void dispatch_cost(const Graph::Adjacency& adjacency, const Metric& metric, Run& run) {
+  switch (metric.type) {
+  case Metric::TIME:
+    run(TimeCost(adjacency, metric));
+    break;
+  case Metric::DISTANCE:
+    run(DistanceCost(adjacency, metric));
+    break;
+  case Metric::WEIGHTED:
+    run(WeightedCost(adjacency, metric));
+    break;
+  }
+}
+
+#endif // SEARCH_POLICIES_H
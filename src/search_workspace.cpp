@@ -0,0 +1,53 @@
+#include "search_workspace.h"
+#include <algorithm>
+#include <stdexcept>
+
+SearchWorkspace::SearchWorkspace(int node_count, HeapType dijkstra_heap)
+  : cost_(node_count), parent_(node_count), reached_(node_count, 0), settled_(node_count, 0),
+    marked_(node_count, 0), dary_(node_count), heap_type_(HEAP_DARY), dijkstra_heap_(dijkstra_heap), epoch_(0) {}
+
+SearchWorkspace::HeapType SearchWorkspace::parse_heap(const std::string& heap) {
+  if (heap == "dary") return HEAP_DARY;
+  if (heap == "radix") return HEAP_RADIX;
+  throw std::runtime_error("Invalid heap: " + heap);
+}
+
+void SearchWorkspace::reset(HeapType heap) {
+  dary_.clear();
+  radix_.clear();
+  heap_type_ = heap;
+
+  // Epoch 0 marks untouched entries; clear the stamps when the counter wraps
+  if (++epoch_ == 0) {
+    std::fill(reached_.begin(), reached_.end(), 0);
+    std::fill(settled_.begin(), settled_.end(), 0);
+    std::fill(marked_.begin(), marked_.end(), 0);
+    epoch_ = 1;
+  }
+}
+
+
+std::unique_ptr<SearchWorkspace> WorkspacePool::acquire() {
+  SearchWorkspace::HeapType heap;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    heap = dijkstra_heap_;
+    if (!free_.empty()) {
+      std::unique_ptr<SearchWorkspace> workspace = std::move(free_.back());
+      free_.pop_back();
+      workspace->set_dijkstra_heap(heap);
+      return workspace;
+    }
+  }
+  return std::unique_ptr<SearchWorkspace>(new SearchWorkspace(node_count_, heap));
+}
+
+void WorkspacePool::set_dijkstra_heap(SearchWorkspace::HeapType heap) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  dijkstra_heap_ = heap;
+}
+
+void WorkspacePool::release(std::unique_ptr<SearchWorkspace> workspace) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  free_.push_back(std::move(workspace));
+}
@@ -0,0 +1,134 @@
+#ifndef SEARCH_WORKSPACE_H
+#define SEARCH_WORKSPACE_H
+
+#include "heaps.h"
+#include <vector>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <limits>
+#include <utility>
+#include <cstdint>
+
+// Scratch state of one shortest path search: tentative costs and parents,
+// settled and marked flags, and the priority queue. Every entry carries the
+// epoch of the search that wrote it, so reset() starts a new search in O(1)
+// and entries left over from earlier searches read as untouched.
+class SearchWorkspace {
+public:
+  using NodeCostPair = std::pair<double, int>;
+
+  // Priority queue of a search: the indexed 4-ary heap works for any search,
+  // the radix heap only for monotone ones such as Dijkstra
+  enum HeapType {
+    HEAP_DARY,
+    HEAP_RADIX
+  };
+  static HeapType parse_heap(const std::string& heap);
+
+  explicit SearchWorkspace(int node_count, HeapType dijkstra_heap = HEAP_DARY);
+
+  // Start a new search
+  void reset(HeapType heap = HEAP_DARY);
+  int node_count() const { return static_cast<int>(cost_.size()); }
+
+  // Heap of the plain Dijkstra kernels (one-to-many, isochrone and search
+  // tree); the other searches always use the 4-ary heap
+  HeapType dijkstra_heap() const { return dijkstra_heap_; }
+  void set_dijkstra_heap(HeapType heap) { dijkstra_heap_ = heap; }
+
+  // Tentative cost and parent of a node (max() and -1 if not reached)
+  double cost(int node) const {
+    return reached_[node] == epoch_ ? cost_[node] : std::numeric_limits<double>::max();
+  }
+  int parent(int node) const {
+    return reached_[node] == epoch_ ? parent_[node] : -1;
+  }
+  void update(int node, double cost, int parent = -1) {
+    reached_[node] = epoch_;
+    cost_[node] = cost;
+    parent_[node] = parent;
+  }
+
+  bool settled(int node) const { return settled_[node] == epoch_; }
+  void settle(int node) { settled_[node] = epoch_; }
+
+  // Free flag per node, e.g. for the targets of a search
+  bool marked(int node) const { return marked_[node] == epoch_; }
+  void mark(int node) { marked_[node] = epoch_; }
+  void unmark(int node) { marked_[node] = 0; }
+
+  // Min-priority queue of (cost, node) pairs; its storage is kept between
+  // searches. Pushing a queued node lowers its cost in the 4-ary heap and
+  // adds a second entry to the radix heap, which the search skips as stale.
+  bool empty() const { return heap_type_ == HEAP_DARY ? dary_.empty() : radix_.empty(); }
+  const NodeCostPair& top() { return heap_type_ == HEAP_DARY ? dary_.top() : radix_.top(); }
+  void push(double cost, int node) {
+    if (heap_type_ == HEAP_DARY) {
+      dary_.push(cost, node);
+    } else {
+      radix_.push(cost, node);
+    }
+  }
+  void pop() {
+    if (heap_type_ == HEAP_DARY) {
+      dary_.pop();
+    } else {
+      radix_.pop();
+    }
+  }
+
+private:
+  std::vector<double> cost_;
+  std::vector<int> parent_;
+  std::vector<std::uint32_t> reached_;
+  std::vector<std::uint32_t> settled_;
+  std::vector<std::uint32_t> marked_;
+  DaryHeap dary_;
+  RadixHeap radix_;
+  HeapType heap_type_;
+  HeapType dijkstra_heap_;
+  std::uint32_t epoch_;
+};
+
+// Workspaces of a graph, shared by its parallel workers. A worker leases one
+// workspace per chunk of queries; returned workspaces are kept for later
+// queries, so the pool holds at most one workspace per concurrent thread.
+class WorkspacePool {
+public:
+  explicit WorkspacePool(int node_count) : node_count_(node_count), dijkstra_heap_(SearchWorkspace::HEAP_DARY) {}
+
+  WorkspacePool(const WorkspacePool&) = delete;
+  WorkspacePool& operator=(const WorkspacePool&) = delete;
+
+  // Workspace that is returned to the pool when the lease goes out of scope
+  class Lease {
+  public:
+    explicit Lease(WorkspacePool& pool) : pool_(pool), workspace_(pool.acquire()) {}
+    ~Lease() { pool_.release(std::move(workspace_)); }
+
+    Lease(const Lease&) = delete;
+    Lease& operator=(const Lease&) = delete;
+
+    SearchWorkspace& operator*() const { return *workspace_; }
+    SearchWorkspace* operator->() const { return workspace_.get(); }
+
+  private:
+    WorkspacePool& pool_;
+    std::unique_ptr<SearchWorkspace> workspace_;
+  };
+
+  // Heap of the Dijkstra kernels in the workspaces leased from now on
+  void set_dijkstra_heap(SearchWorkspace::HeapType heap);
+
+private:
+  std::unique_ptr<SearchWorkspace> acquire();
+  void release(std::unique_ptr<SearchWorkspace> workspace);
+
+  int node_count_;
+  SearchWorkspace::HeapType dijkstra_heap_;
+  std::mutex mutex_;
+  std::vector<std::unique_ptr<SearchWorkspace>> free_;
+};
+
+#endif // SEARCH_WORKSPACE_H
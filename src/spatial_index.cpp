@@ -0,0 +1,155 @@
+#include "spatial_index.h"
+#include "parallel.h"
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+// Constructor: the cell size is chosen for about two nodes per cell, and at
+// least 1/n of the longer side of the bounding box so that the grid stays
+// small for networks along a line
+SpatialIndex::SpatialIndex(const Graph& graph, int profile) {
+  std::vector<Graph::Node> nodes = graph.nodes(profile);
+  size_t n = nodes.size();
+
+  min_x_ = 0.0;
+  min_y_ = 0.0;
+  double max_x = 0.0;
+  double max_y = 0.0;
+  if (n > 0) {
+    min_x_ = max_x = nodes[0].x;
+    min_y_ = max_y = nodes[0].y;
+  }
+  for (const Graph::Node& node : nodes) {
+    min_x_ = std::min(min_x_, node.x);
+    min_y_ = std::min(min_y_, node.y);
+    max_x = std::max(max_x, node.x);
+    max_y = std::max(max_y, node.y);
+  }
+
+  double width = max_x - min_x_;
+  double height = max_y - min_y_;
+  double target_cells = std::max(1.0, n / 2.0);
+  cell_size_ = std::max(std::sqrt(width * height / target_cells), std::max(width, height) / target_cells);
+  if (!(cell_size_ > 0)) {
+    cell_size_ = 1.0;
+  }
+  columns_ = n > 0 ? static_cast<int>(width / cell_size_) + 1 : 0;
+  rows_ = n > 0 ? static_cast<int>(height / cell_size_) + 1 : 0;
+
+  // Bucket the nodes by cell (counting sort), keeping their coordinates next
+  // to them for cache-friendly scans
+  std::vector<int> cell(n);
+  offsets_.assign(static_cast<size_t>(columns_) * rows_ + 1, 0);
+  for (size_t i = 0; i < n; ++i) {
+    cell[i] = row(nodes[i].y) * columns_ + column(nodes[i].x);
+    offsets_[cell[i] + 1]++;
+  }
+  for (size_t c = 0; c + 1 < offsets_.size(); ++c) {
+    offsets_[c + 1] += offsets_[c];
+  }
+
+  std::vector<int> position(offsets_.begin(), offsets_.end() - 1);
+  nodes_.resize(n);
+  x_.resize(n);
+  y_.resize(n);
+  for (size_t i = 0; i < n; ++i) {
+    int pos = position[cell[i]]++;
+    nodes_[pos] = nodes[i].id;
+    x_[pos] = nodes[i].x;
+    y_[pos] = nodes[i].y;
+  }
+}
+
+int SpatialIndex::column(double x) const {
+  double c = std::floor((x - min_x_) / cell_size_);
+  return static_cast<int>(std::max(0.0, std::min(c, columns_ - 1.0)));
+}
+
+int SpatialIndex::row(double y) const {
+  double r = std::floor((y - min_y_) / cell_size_);
+  return static_cast<int>(std::max(0.0, std::min(r, rows_ - 1.0)));
+}
+
+// Scans rings of cells around the cell of (x, y) until no unvisited cell can
+// hold a node closer than the best one found so far
+int SpatialIndex::nearest(double x, double y, double max_dist, double& dist) const {
+  dist = std::numeric_limits<double>::infinity();
+  if (nodes_.empty() || !std::isfinite(x) || !std::isfinite(y)) {
+    return -1;
+  }
+
+  int cx = column(x);
+  int cy = row(y);
+  int best = -1;
+  double best_d2 = std::numeric_limits<double>::infinity();
+
+  for (int r = 0; ; ++r) {
+    int x0 = cx - r, x1 = cx + r, y0 = cy - r, y1 = cy + r;
+    for (int j = std::max(y0, 0); j <= std::min(y1, rows_ - 1); ++j) {
+      // Only the border of the ring is new
+      int step = (j == y0 || j == y1) ? 1 : std::max(1, x1 - x0);
+      for (int i = x0; i <= x1; i += step) {
+        if (i < 0 || i >= columns_) {
+          continue;
+        }
+        int c = j * columns_ + i;
+        for (int k = offsets_[c]; k < offsets_[c + 1]; ++k) {
+          double dx = x_[k] - x;
+          double dy = y_[k] - y;
+          double d2 = dx * dx + dy * dy;
+          if (d2 < best_d2 || (d2 == best_d2 && nodes_[k] < best)) {
+            best_d2 = d2;
+            best = nodes_[k];
+          }
+        }
+      }
+    }
+
+    // Lower bound of the distance to any cell outside the rings seen so far,
+    // over the sides of the grid that still have such cells
+    double bound = std::numeric_limits<double>::infinity();
+    if (x0 > 0) bound = std::min(bound, x - (min_x_ + x0 * cell_size_));
+    if (x1 < columns_ - 1) bound = std::min(bound, min_x_ + (x1 + 1) * cell_size_ - x);
+    if (y0 > 0) bound = std::min(bound, y - (min_y_ + y0 * cell_size_));
+    if (y1 < rows_ - 1) bound = std::min(bound, min_y_ + (y1 + 1) * cell_size_ - y);
+    if (bound == std::numeric_limits<double>::infinity() || bound > max_dist ||
+        (bound > 0 && best_d2 <= bound * bound)) {
+      break;
+    }
+  }
+
+  if (best < 0 || std::sqrt(best_d2) > max_dist) {
+    return -1;
+  }
+  dist = std::sqrt(best_d2);
+  return best;
+}
+
+
+// Parallel snapping: every worker range answers its points independently
+class SnapWorker : public parallel::Worker {
+public:
+  SnapWorker(const SpatialIndex& index, const std::vector<double>& x, const std::vector<double>& y,
+             double max_dist, int* node, double* dist)
+    : index_(index), x_(x), y_(y), max_dist_(max_dist), node_(node), dist_(dist) {}
+
+  void operator()(std::size_t begin, std::size_t end) {
+    for (std::size_t i = begin; i < end; ++i) {
+      node_[i] = index_.nearest(x_[i], y_[i], max_dist_, dist_[i]);
+    }
+  }
+
+private:
+  const SpatialIndex& index_;
+  const std::vector<double>& x_;
+  const std::vector<double>& y_;
+  double max_dist_;
+  int* node_;
+  double* dist_;
+};
+
+void parallelSnap(const SpatialIndex& index, const std::vector<double>& x, const std::vector<double>& y,
+                  double max_dist, int* node, double* dist) {
+  SnapWorker worker(index, x, y, max_dist, node, dist);
+  parallel::parallelFor(0, x.size(), worker);
+}
@@ -0,0 +1,42 @@
+#ifndef SPATIAL_INDEX_H
+#define SPATIAL_INDEX_H
+
+#include "graph.h"
+#include <vector>
+
+// Uniform grid over the node coordinates of a routing profile, used to snap
+// points to their nearest node. Cells are stored in compressed sparse row
+// form: the nodes of cell c are nodes_[offsets_[c] .. offsets_[c + 1] - 1].
+class SpatialIndex {
+public:
+  // Constructor: indexes the nodes used by a routing profile of the graph
+  SpatialIndex(const Graph& graph, int profile);
+
+  // Nearest node to (x, y) within max_dist, or -1 if there is none; dist
+  // receives the Euclidean distance to it
+  int nearest(double x, double y, double max_dist, double& dist) const;
+
+private:
+  // Member variables
+  double min_x_;
+  double min_y_;
+  double cell_size_;
+  int columns_;
+  int rows_;
+  std::vector<int> offsets_;
+  std::vector<int> nodes_;
+  std::vector<double> x_;
+  std::vector<double> y_;
+
+  // Helper methods
+  int column(double x) const;
+  int row(double y) const;
+};
+
+// Snaps every point (x[i], y[i]) to its nearest node within max_dist, in
+// parallel. node[i] receives the node id (-1 if none is within reach) and
+// dist[i] the distance to it.
+void parallelSnap(const SpatialIndex& index, const std::vector<double>& x, const std::vector<double>& y,
+                  double max_dist, int* node, double* dist);
+
+#endif // SPATIAL_INDEX_H
@@ -0,0 +1,85 @@
+#include "tree_cache.h"
+#include <functional>
+
+TreeCache::TreeCache(std::size_t capacity)
+  : capacity_(capacity), bytes_(0), hits_(0), extensions_(0), misses_(0), evictions_(0) {}
+
+std::size_t TreeCache::KeyHash::operator()(const Key& key) const {
+  std::size_t hash = std::hash<int>()(key.start);
+  hash = hash * 31 + std::hash<int>()(key.profile);
+  hash = hash * 31 + std::hash<double>()(key.time);
+  hash = hash * 31 + std::hash<double>()(key.distance);
+  return hash;
+}
+
+std::shared_ptr<const SearchTree> TreeCache::find(const Key& key) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = index_.find(key);
+  if (it == index_.end()) {
+    return nullptr;
+  }
+  entries_.splice(entries_.begin(), entries_, it->second);
+  return it->second->second;
+}
+
+void TreeCache::insert(const Key& key, std::shared_ptr<const SearchTree> tree) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = index_.find(key);
+  if (it != index_.end()) {
+    bytes_ -= it->second->second->bytes();
+    entries_.erase(it->second);
+    index_.erase(it);
+  }
+  if (tree->bytes() > capacity_) {
+    return;
+  }
+
+  evict(capacity_ - tree->bytes());
+  bytes_ += tree->bytes();
+  entries_.emplace_front(key, std::move(tree));
+  index_.emplace(key, entries_.begin());
+}
+
+void TreeCache::count(Lookup lookup) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  switch (lookup) {
+  case HIT:
+    hits_++;
+    break;
+  case EXTENSION:
+    extensions_++;
+    break;
+  case MISS:
+    misses_++;
+    break;
+  }
+}
+
+TreeCache::Stats TreeCache::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Stats stats = {hits_, extensions_, misses_, evictions_, entries_.size(), bytes_, capacity_};
+  return stats;
+}
+
+void TreeCache::clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  entries_.clear();
+  index_.clear();
+  bytes_ = 0;
+}
+
+void TreeCache::set_capacity(std::size_t capacity) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  capacity_ = capacity;
+  evict(capacity);
+}
+
+// Evict least recently used trees until they take at most capacity bytes
+void TreeCache::evict(std::size_t capacity) {
+  while (bytes_ > capacity) {
+    bytes_ -= entries_.back().second->bytes();
+    index_.erase(entries_.back().first);
+    entries_.pop_back();
+    evictions_++;
+  }
+}
@@ -0,0 +1,269 @@
+#ifndef TREE_CACHE_H
+#define TREE_CACHE_H
+
+#include "graph.h"
+#include "search_workspace.h"
+#include "search_policies.h"
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <limits>
+#include <algorithm>
+#include <utility>
+#include <iterator>
+#include <cstddef>
+#include <cstdint>
+
+// Shortest path tree of a start node, cut at a radius: the costs of all nodes
+// within radius of the start node, ordered by cost and node, in two compact
+// arrays, and the positions of the labels ordered by node for lookups. The
+// radius is infinite once the tree holds every reachable node.
+struct SearchTree {
+  double radius;
+  std::vector<double> cost;
+  std::vector<int> node;
+  std::vector<int> by_node;
+
+  std::size_t size() const { return node.size(); }
+  std::size_t bytes() const { return sizeof(SearchTree) + node.size() * (sizeof(double) + 2 * sizeof(int)); }
+  bool complete() const { return radius == std::numeric_limits<double>::infinity(); }
+
+  // Cost of a node in the tree, by binary search; the maximum double if the
+  // node is not in the tree
+  double cost_of(int target) const {
+    std::vector<int>::const_iterator it = std::lower_bound(by_node.begin(), by_node.end(), target,
+                                                           [this](int label, int value) { return node[label] < value; });
+    if (it == by_node.end() || node[*it] != target) {
+      return std::numeric_limits<double>::max();
+    }
+    return cost[*it];
+  }
+};
+
+// Memory-bounded LRU cache of search trees, shared by the parallel workers of
+// a graph. A tree is keyed by profile, metric and start node; there is one
+// tree per key, and growing it to a larger radius replaces it. Once the trees
+// exceed the capacity in bytes, the least recently used ones are evicted.
+class TreeCache {
+public:
+  struct Key {
+    int profile;
+    double time;
+    double distance;
+    int start;
+
+    Key(int profile, const Metric& metric, int start)
+      : profile(profile), time(metric.time), distance(metric.distance), start(start) {}
+    bool operator==(const Key& other) const {
+      return profile == other.profile && time == other.time && distance == other.distance && start == other.start;
+    }
+  };
+
+  // How a search was served: by a cached tree, by growing a cached tree, or
+  // by a search from scratch
+  enum Lookup {
+    HIT,
+    EXTENSION,
+    MISS
+  };
+
+  struct Stats {
+    std::uint64_t hits;
+    std::uint64_t extensions;
+    std::uint64_t misses;
+    std::uint64_t evictions;
+    std::size_t entries;
+    std::size_t bytes;
+    std::size_t capacity;
+  };
+
+  explicit TreeCache(std::size_t capacity);
+
+  TreeCache(const TreeCache&) = delete;
+  TreeCache& operator=(const TreeCache&) = delete;
+
+  // Cached tree of a key (nullptr if there is none), which becomes the most
+  // recently used one
+  std::shared_ptr<const SearchTree> find(const Key& key);
+
+  // Store the tree of a key, replacing any earlier one, and evict trees beyond
+  // the capacity. A tree larger than the whole capacity is not stored.
+  void insert(const Key& key, std::shared_ptr<const SearchTree> tree);
+
+  void count(Lookup lookup);
+  Stats stats() const;
+
+  // Drop all trees, e.g. when edge weights change; the counters are kept
+  void clear();
+  void set_capacity(std::size_t capacity);
+
+private:
+  struct KeyHash {
+    std::size_t operator()(const Key& key) const;
+  };
+  typedef std::list<std::pair<Key, std::shared_ptr<const SearchTree>>> Entries;
+
+  void evict(std::size_t capacity);
+
+  mutable std::mutex mutex_;
+  Entries entries_;
+  std::unordered_map<Key, Entries::iterator, KeyHash> index_;
+  std::size_t capacity_;
+  std::size_t bytes_;
+  std::uint64_t hits_;
+  std::uint64_t extensions_;
+  std::uint64_t misses_;
+  std::uint64_t evictions_;
+};
+
+
+// Dijkstra search that grows the tree of start_node from base, or from
+// scratch if base is null. The nodes of base keep their costs and only their
+// arcs are relaxed again, so the queue starts at the frontier of base. Without
+// targets, the search settles every node within radius. With targets (each
+// within the new tree or unreachable), it settles them all plus the nodes tied
+// with the last one, whose cost becomes the radius. On return, the workspace
+// holds the costs of the grown tree.
+template <typename Cost, typename Counters>
+std::shared_ptr<const SearchTree> grow_search_tree(const Graph::Adjacency& adjacency, const Cost& cost, int start_node,
+                                                   const SearchTree* base, double radius, const std::vector<int>* targets,
+                                                   SearchWorkspace& workspace, Counters& counters) {
+  std::shared_ptr<SearchTree> tree = std::make_shared<SearchTree>();
+  workspace.reset(workspace.dijkstra_heap());
+
+  if (base) {
+    tree->cost = base->cost;
+    tree->node = base->node;
+    for (std::size_t k = 0; k < base->size(); ++k) {
+      workspace.update(base->node[k], base->cost[k]);
+    }
+    for (std::size_t k = 0; k < base->size(); ++k) {
+      int node = base->node[k];
+      for (int e = adjacency.offsets[node]; e < adjacency.offsets[node + 1]; ++e) {
+        int to = adjacency.targets[e];
+        double new_cost = base->cost[k] + cost(e);
+        counters.relax();
+        if (new_cost < workspace.cost(to)) {
+          workspace.update(to, new_cost, node);
+          workspace.push(new_cost, to);
+          counters.push();
+        }
+      }
+    }
+  } else {
+    workspace.update(start_node, 0.0);
+    workspace.push(0.0, start_node);
+    counters.push();
+  }
+
+  // Distinct targets outside base, which are marked until they are settled
+  double limit = radius;
+  int targets_left = 0;
+  if (targets) {
+    double base_radius = base ? base->radius : -1.0;
+    for (int target : *targets) {
+      if (workspace.cost(target) > base_radius && !workspace.marked(target)) {
+        workspace.mark(target);
+        targets_left++;
+      }
+    }
+    limit = targets_left > 0 ? std::numeric_limits<double>::infinity() : std::max(base_radius, 0.0);
+  }
+
+  std::vector<std::pair<double, int>> grown;
+  while (!workspace.empty()) {
+    double current_cost = workspace.top().first;
+    int current_node = workspace.top().second;
+    if (current_cost > limit) {
+      break;
+    }
+    workspace.pop();
+
+    // Skip stale queue entries
+    if (current_cost > workspace.cost(current_node)) {
+      counters.stale();
+      continue;
+    }
+    counters.settle();
+    grown.push_back(std::make_pair(current_cost, current_node));
+
+    if (targets && workspace.marked(current_node)) {
+      workspace.unmark(current_node);
+      if (--targets_left == 0) {
+        limit = current_cost;
+      }
+    }
+
+    for (int e = adjacency.offsets[current_node]; e < adjacency.offsets[current_node + 1]; ++e) {
+      int to = adjacency.targets[e];
+      double new_cost = current_cost + cost(e);
+      counters.relax();
+      if (new_cost < workspace.cost(to)) {
+        workspace.update(to, new_cost, current_node);
+        workspace.push(new_cost, to);
+        counters.push();
+      }
+    }
+  }
+
+  // Grown nodes lie beyond the radius of base; ties still have to be ordered by node
+  std::sort(grown.begin(), grown.end());
+  tree->cost.reserve(tree->size() + grown.size());
+  tree->node.reserve(tree->size() + grown.size());
+  for (const auto& entry : grown) {
+    tree->cost.push_back(entry.first);
+    tree->node.push_back(entry.second);
+  }
+  tree->radius = workspace.empty() ? std::numeric_limits<double>::infinity() : limit;
+
+  // Grown labels follow the labels of base, whose node order is merged in
+  std::size_t base_size = base ? base->size() : 0;
+  const std::vector<int>& node = tree->node;
+  std::vector<int> grown_by_node(tree->size() - base_size);
+  for (std::size_t k = 0; k < grown_by_node.size(); ++k) {
+    grown_by_node[k] = static_cast<int>(base_size + k);
+  }
+  std::sort(grown_by_node.begin(), grown_by_node.end(), [&node](int a, int b) { return node[a] < node[b]; });
+  if (base) {
+    tree->by_node.reserve(tree->size());
+    std::merge(base->by_node.begin(), base->by_node.end(), grown_by_node.begin(), grown_by_node.end(),
+               std::back_inserter(tree->by_node), [&node](int a, int b) { return node[a] < node[b]; });
+  } else {
+    tree->by_node.swap(grown_by_node);
+  }
+  return tree;
+}
+
+// Tree of the start node of key that covers radius, or all targets if given:
+// read from the cache, grown from a cached tree or searched from scratch, and
+// then cached. A target outside the returned tree is unreachable. A cached
+// tree answers targets by lookup; the workspace is only used to grow a tree.
+// Counters only count the work of growing the tree.
+template <typename Cost, typename Counters>
+std::shared_ptr<const SearchTree> cached_search_tree(TreeCache& cache, const TreeCache::Key& key, const Graph::Adjacency& adjacency,
+                                                     const Cost& cost, double radius, const std::vector<int>* targets,
+                                                     SearchWorkspace& workspace, Counters& counters) {
+  std::shared_ptr<const SearchTree> tree = cache.find(key);
+  if (tree) {
+    bool covered = tree->radius >= radius;
+    if (targets) {
+      const SearchTree& cached = *tree;
+      covered = tree->complete() || std::all_of(targets->begin(), targets->end(), [&cached](int target) {
+        return cached.cost_of(target) < std::numeric_limits<double>::max();
+      });
+    }
+    if (covered) {
+      cache.count(TreeCache::HIT);
+      return tree;
+    }
+  }
+
+  cache.count(tree ? TreeCache::EXTENSION : TreeCache::MISS);
+  std::shared_ptr<const SearchTree> grown = grow_search_tree(adjacency, cost, key.start, tree.get(), radius, targets, workspace, counters);
+  cache.insert(key, grown);
+  return grown;
+}
+
+#endif // TREE_CACHE_H